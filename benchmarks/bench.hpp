@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+
+// Benchmarks are plain executables: every Measure call prints one line with the best time per operation
+
+// Keeps the compiler from dropping a computation whose result is otherwise unused
+template<typename T>
+inline void DoNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs func, which performs count operations, repeats times. Best run wins, the others
+// only differ by noise from the rest of the machine
+template<typename Func>
+double Measure(const char *name, std::size_t count, Func func, int repeats = 5) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / count);
+    }
+    std::printf("%-48s %10.2f ns/op\n", name, best);
+    return best;
+}
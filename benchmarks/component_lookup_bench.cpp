@@ -0,0 +1,86 @@
+#include "engine.hpp"
+#include "bench.hpp"
+
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+struct Position {
+    float x, y;
+};
+
+struct Velocity {
+    float x, y;
+};
+
+// Lookup components had before static ids: the name of the type is turned into a string
+// and hashed into a map from names to ids, once to verify registration and once to find the array
+class NameLookup {
+    std::unordered_map<std::string, Component> _name_to_component_index;
+    std::vector<IComponentArray *> _components;
+
+public:
+    template<typename T>
+    void Register(Engine &engine) {
+        _name_to_component_index.insert({ typeid(T).name(), Component(_components.size()) });
+        _components.push_back(&engine.GetComponentArray<T>());
+    }
+
+    template<typename T>
+    ComponentArray<T> &GetComponentArray() {
+        std::string type_name = typeid(T).name();
+        DoNotOptimize(_name_to_component_index.find(type_name) != _name_to_component_index.end());
+
+        type_name = typeid(T).name();
+        Component id = _name_to_component_index.find(type_name)->second;
+        return static_cast<ComponentArray<T> &>(*_components[id]);
+    }
+};
+
+int main() {
+    constexpr EntityIndex COUNT = 100000;
+
+    Engine engine;
+    engine.RegisterComponentTypes<Position, Velocity>();
+    std::vector<Entity> entities = engine.CreateEntities(COUNT, Position { 0, 0 }, Velocity { 1, 1 });
+
+    NameLookup names;
+    names.Register<Position>(engine);
+    names.Register<Velocity>(engine);
+
+    // Integrates positions one entity at a time, the way per-entity inner loops access components
+    Measure("get: typeid string lookup", COUNT, [&]() {
+        for (Entity entity : entities) {
+            Position &position = names.GetComponentArray<Position>().GetData(GetEntityIndex(entity));
+            const Velocity &velocity = names.GetComponentArray<Velocity>().GetData(GetEntityIndex(entity));
+            position.x += velocity.x;
+            position.y += velocity.y;
+        }
+    });
+
+    Measure("get: static id", COUNT, [&]() {
+        for (Entity entity : entities) {
+            Position &position = engine.GetComponent<Position>(entity);
+            const Velocity &velocity = engine.ReadComponent<Velocity>(entity);
+            position.x += velocity.x;
+            position.y += velocity.y;
+        }
+    });
+
+    // Same set as below, plus the two name lookups it used to make
+    Measure("set: typeid string lookup", COUNT, [&]() {
+        for (Entity entity : entities) {
+            DoNotOptimize(&names.GetComponentArray<Velocity>());
+            engine.SetComponent(entity, Velocity { 2, 2 });
+        }
+    });
+
+    Measure("set: static id", COUNT, [&]() {
+        for (Entity entity : entities)
+            engine.SetComponent(entity, Velocity { 2, 2 });
+    });
+
+    DoNotOptimize(engine.ReadComponent<Position>(entities.back()));
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "engine.hpp"
+#include "bench.hpp"
+
+#include <bitset>
+#include <utility>
+#include <vector>
+
+template<int N>
+struct Part {
+    int value;
+};
+
+struct Churned {
+    int value;
+};
+
+// Three of thirty systems mention the churned component, the rest require two others
+template<int N>
+class Trivial : public System {
+public:
+    Trivial(Engine &engine) : System(engine, N % 10 == 0
+        ? engine.ConstructSignature<Part<N % 10>, Churned>()
+        : engine.ConstructSignature<Part<N % 10>, Part<(N + 1) % 10>>()) {}
+
+    void Update(float) override {}
+};
+
+template<int ...Ns>
+void RegisterSystems(Engine &engine, std::vector<System *> &systems, std::integer_sequence<int, Ns...>) {
+    (systems.push_back(&engine.RegisterSystem<Trivial<Ns>>()), ...);
+}
+
+template<int ...Ns>
+void RegisterComponents(Engine &engine, std::integer_sequence<int, Ns...>) {
+    (engine.RegisterComponentType<Part<Ns>>(), ...);
+    engine.RegisterComponentType<Churned>();
+}
+
+template<int ...Ns>
+std::vector<Entity> CreateEntities(Engine &engine, EntityIndex count, std::integer_sequence<int, Ns...>) {
+    return engine.CreateEntities(count, Part<Ns> { Ns }...);
+}
+
+// Churn of one component on entities having every other one, so every system is a candidate
+int main() {
+    constexpr EntityIndex COUNT = 10000;
+
+    Engine bare;
+    RegisterComponents(bare, std::make_integer_sequence<int, 10>());
+    std::vector<Entity> bare_entities = CreateEntities(bare, COUNT, std::make_integer_sequence<int, 10>());
+
+    Engine engine;
+    std::vector<System *> systems;
+    RegisterComponents(engine, std::make_integer_sequence<int, 10>());
+    RegisterSystems(engine, systems, std::make_integer_sequence<int, 30>());
+    std::vector<Entity> entities = CreateEntities(engine, COUNT, std::make_integer_sequence<int, 10>());
+
+    Measure("add+remove: no systems", 2 * COUNT, [&]() {
+        for (Entity entity : bare_entities) {
+            bare.SetComponent(entity, Churned { 1 });
+            bare.RemoveComponent<Churned>(entity);
+        }
+    });
+
+    // Only the three signatures which mention the component are checked
+    Measure("add+remove: 30 systems, indexed", 2 * COUNT, [&]() {
+        for (Entity entity : entities) {
+            engine.SetComponent(entity, Churned { 1 });
+            engine.RemoveComponent<Churned>(entity);
+        }
+    });
+
+    // Matching each change used to do before the index: every signature of every system
+    // compared by popcounts of bitsets. Only the checks are timed, not the change itself
+    std::vector<std::bitset<MAX_COMPONENTS>> gates;
+    for (System *system : systems) {
+        std::bitset<MAX_COMPONENTS> gate;
+        system->signatures[0].ForEachComponent([&](Component id) { gate.set(id); });
+        gates.push_back(gate);
+    }
+    std::bitset<MAX_COMPONENTS> components;
+    engine.GetSignature(entities.front()).ForEachComponent([&](Component id) { components.set(id); });
+    Measure("matching alone: 30 systems, full scan", 2 * COUNT, [&]() {
+        for (Entity entity : entities) {
+            for (bool added : { true, false }) {
+                components.set(component_type_id<Churned>, added);
+                for (std::size_t i = 0; i < systems.size(); i++) {
+                    bool accepted = (components & gates[i]).count() == gates[i].count();
+                    DoNotOptimize(accepted != systems[i]->IsEntityProccessed(entity, 0));
+                }
+            }
+        }
+    });
+
+    return 0;
+}
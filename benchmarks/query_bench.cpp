@@ -0,0 +1,84 @@
+#include "engine.hpp"
+#include "bench.hpp"
+
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+template<int N>
+struct Part {
+    int value;
+};
+
+template<int ...Ns>
+void RegisterComponents(Engine &engine, std::integer_sequence<int, Ns...>) {
+    (engine.RegisterComponentType<Part<Ns>>(), ...);
+}
+
+// Every part with a chance of one in eight, so entities have about 25 components spread over every word
+template<int ...Ns>
+void AddRandomParts(Engine &engine, Entity entity, std::mt19937 &rng, std::integer_sequence<int, Ns...>) {
+    auto add = [&](auto part) {
+        if (rng() % 8 == 0)
+            engine.SetComponent(entity, part);
+    };
+    (add(Part<Ns> { Ns }), ...);
+}
+
+// Full-world ad-hoc queries through QueryEntities against Query::Matches, i.e. IsSufficientFor and
+// Intersects, called on every signature of a copy of the table, as QueryEntities did before the
+// block scan. Summing the copy is the lower bound set by memory bandwidth
+int main() {
+    constexpr EntityIndex COUNT = 100000;
+    using Parts = std::make_integer_sequence<int, 200>;
+
+    Engine engine;
+    RegisterComponents(engine, Parts());
+    std::vector<Entity> entities = engine.CreateEntities(COUNT);
+    std::mt19937 rng(11);
+    for (Entity entity : entities)
+        AddRandomParts(engine, entity, rng, Parts());
+    std::vector<Signature> signatures;
+    for (Entity entity : entities)
+        signatures.push_back(engine.GetSignature(entity));
+
+    std::vector<std::pair<const char *, Query>> queries {
+        { "one component", Query().With<Part<0>>() },
+        { "three components", Query().With<Part<0>, Part<100>, Part<199>>() },
+        { "with, without, any of", Query().With<Part<10>>().Without<Part<60>, Part<150>>().AnyOf<Part<30>, Part<190>>() },
+    };
+
+    std::vector<Entity> result;
+    result.reserve(COUNT);
+    char name[64];
+    for (auto &[label, query] : queries) {
+        std::snprintf(name, sizeof(name), "%s: per entity", label);
+        Measure(name, COUNT, [&]() {
+            result.clear();
+            for (EntityIndex i = 0; i < COUNT; i++) {
+                if (query.Matches(signatures[i]))
+                    result.push_back(entities[i]);
+            }
+            DoNotOptimize(result.data());
+        });
+
+        std::snprintf(name, sizeof(name), "%s: QueryEntities", label);
+        Measure(name, COUNT, [&]() {
+            result.clear();
+            engine.QueryEntities(query, result);
+            DoNotOptimize(result.data());
+        });
+    }
+
+    Measure("reading the signature table", COUNT, [&]() {
+        Signature::Word sum = 0;
+        for (const Signature &signature : signatures) {
+            for (Signature::Word word : signature.words)
+                sum += word;
+        }
+        DoNotOptimize(sum);
+    });
+
+    return 0;
+}
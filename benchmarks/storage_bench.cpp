@@ -0,0 +1,94 @@
+#include "engine.hpp"
+#include "archetype.hpp"
+#include "bench.hpp"
+
+#include <vector>
+
+struct Position {
+    float x, y;
+};
+
+struct Velocity {
+    float x, y;
+};
+
+struct Health {
+    int value;
+};
+
+// Packed arrays behind the engine against archetype chunks, with the same mix of signatures:
+// every entity has Position, three of four have Velocity and every other one has Health
+int main() {
+    constexpr EntityIndex COUNT = 100000;
+    constexpr EntityIndex CHURN_COUNT = 10000;
+
+    Engine engine;
+    engine.RegisterComponentTypes<Position, Velocity, Health>();
+
+    ArchetypeStorage archetypes;
+    archetypes.RegisterComponentType<Position>(component_type_id<Position>);
+    archetypes.RegisterComponentType<Velocity>(component_type_id<Velocity>);
+    archetypes.RegisterComponentType<Health>(component_type_id<Health>);
+
+    std::vector<Entity> entities;
+    for (EntityIndex i = 0; i < COUNT; i++) {
+        Entity entity = engine.CreateEntity();
+        entities.push_back(entity);
+
+        Signature signature;
+        signature.AddComponent(component_type_id<Position>);
+        engine.SetComponent(entity, Position { 0, 0 });
+        if (i % 4 != 0) {
+            signature.AddComponent(component_type_id<Velocity>);
+            engine.SetComponent(entity, Velocity { 1, 1 });
+        }
+        if (i % 2 == 0) {
+            signature.AddComponent(component_type_id<Health>);
+            engine.SetComponent(entity, Health { 100 });
+        }
+
+        if (i % 4 == 0)
+            archetypes.Insert(entity, signature, Position { 0, 0 }, Health { 100 });
+        else if (i % 2 == 0)
+            archetypes.Insert(entity, signature, Position { 0, 0 }, Velocity { 1, 1 }, Health { 100 });
+        else
+            archetypes.Insert(entity, signature, Position { 0, 0 }, Velocity { 1, 1 });
+    }
+
+    std::size_t moving = COUNT - COUNT / 4;
+    Measure("iterate Position+Velocity: packed arrays", moving, [&]() {
+        engine.ForEach<Position, const Velocity>([](Position &position, const Velocity &velocity) {
+            position.x += velocity.x;
+            position.y += velocity.y;
+        });
+    });
+
+    Measure("iterate Position+Velocity: archetypes", moving, [&]() {
+        archetypes.ForEach<Position, Velocity>([](Position &position, Velocity &velocity) {
+            position.x += velocity.x;
+            position.y += velocity.y;
+        });
+    });
+
+    // Adding and removing a component moves the whole row between archetypes
+    Measure("add+remove Health: packed arrays", 2 * CHURN_COUNT, [&]() {
+        for (EntityIndex i = 1; i < 2 * CHURN_COUNT; i += 2) {
+            engine.SetComponent(entities[i], Health { 1 });
+            engine.RemoveComponent<Health>(entities[i]);
+        }
+    });
+
+    Measure("add+remove Health: archetypes", 2 * CHURN_COUNT, [&]() {
+        for (EntityIndex i = 1; i < 2 * CHURN_COUNT; i += 2) {
+            archetypes.Set(entities[i], component_type_id<Health>, Health { 1 });
+            archetypes.Remove(entities[i], component_type_id<Health>);
+        }
+    });
+
+    std::printf("%-48s %10zu bytes\n", "memory: packed arrays", engine.GetPoolMemory().reserved);
+    std::printf("%-48s %10zu bytes\n", "memory: archetypes", archetypes.GetMemoryUsage());
+
+    DoNotOptimize(engine.ReadComponent<Position>(entities.back()));
+    DoNotOptimize(archetypes.Get<Position>(entities.back(), component_type_id<Position>));
+    return 0;
+}
@@ -0,0 +1,466 @@
+#pragma once
+
+#include "constants.hpp"
+#include "entity.hpp"
+#include "component.hpp"
+#include "view.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+constexpr std::size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+constexpr std::size_t ARCHETYPE_CHUNK_ALIGNMENT = 64;
+
+// Type-erased operations archetype needs to shuffle components around
+struct ComponentInfo {
+    std::size_t size = 0;
+    std::size_t alignment = 0;
+    void (*move_construct)(void *destination, void *source) = nullptr;
+    void (*copy_construct)(void *destination, const void *source) = nullptr;
+    void (*destroy)(void *object) = nullptr;
+
+    template<typename T>
+    static ComponentInfo Of() {
+        ComponentInfo info;
+        info.size = sizeof(T);
+        info.alignment = alignof(T);
+        info.move_construct = [](void *destination, void *source) {
+            new (destination) T(std::move(*static_cast<T *>(source)));
+        };
+        info.copy_construct = [](void *destination, const void *source) {
+            new (destination) T(*static_cast<const T *>(source));
+        };
+        info.destroy = [](void *object) {
+            static_cast<T *>(object)->~T();
+        };
+        return info;
+    }
+
+    bool IsValid() const {
+        return size != 0;
+    }
+};
+
+// Block of memory holding `capacity` entities of one archetype. ARCHETYPE_CHUNK_SIZE bytes,
+// unless a single row is larger. Layout: [Entity entities[capacity]][column 0][column 1]...
+struct ArchetypeChunk {
+    std::byte *data;
+    std::uint32_t count;
+
+    explicit ArchetypeChunk(std::size_t size) : count(0) {
+        data = static_cast<std::byte *>(::operator new(size, std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT)));
+    }
+
+    ~ArchetypeChunk() {
+        ::operator delete(data, std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT));
+    }
+
+    ArchetypeChunk(const ArchetypeChunk &) = delete;
+    ArchetypeChunk &operator=(const ArchetypeChunk &) = delete;
+
+    Entity *GetEntities() {
+        return reinterpret_cast<Entity *>(data);
+    }
+};
+
+// All entities sharing exactly the same signature
+class Archetype {
+    static constexpr std::uint32_t NO_COLUMN = ~0u;
+
+    std::array<std::uint32_t, MAX_COMPONENTS> _offsets;
+    std::array<const ComponentInfo *, MAX_COMPONENTS> _infos;
+    std::vector<Component> _component_ids;
+    std::vector<std::unique_ptr<ArchetypeChunk>> _chunks;
+    std::uint32_t _chunk_capacity;
+    std::size_t _chunk_size;
+    std::uint32_t _entity_count;
+
+public:
+    Signature signature;
+
+    // Cached transitions when a single component is added or removed
+    std::array<Archetype *, MAX_COMPONENTS> add_edges;
+    std::array<Archetype *, MAX_COMPONENTS> remove_edges;
+
+    Archetype(const Signature &sig, const std::array<ComponentInfo, MAX_COMPONENTS> &infos)
+        : _entity_count(0), signature(sig) {
+        _offsets.fill(NO_COLUMN);
+        _infos.fill(nullptr);
+        add_edges.fill(nullptr);
+        remove_edges.fill(nullptr);
+
+        std::size_t row_size = sizeof(Entity);
+        signature.ForEachComponent([&](Component id) {
+            assert(infos[id].IsValid() && "Archetype uses component that hasn't been registered");
+            _infos[id] = &infos[id];
+            _component_ids.push_back(id);
+            row_size += infos[id].size;
+        });
+
+        // Shrink capacity until columns fit with their alignment padding.
+        // A row which does not fit on its own gets chunks of its size
+        _chunk_capacity = std::max<std::size_t>(ARCHETYPE_CHUNK_SIZE / row_size, 1);
+        while (LayoutColumns() > ARCHETYPE_CHUNK_SIZE && _chunk_capacity > 1) {
+            _chunk_capacity--;
+        }
+        _chunk_size = std::max(LayoutColumns(), ARCHETYPE_CHUNK_SIZE);
+    }
+
+    std::uint32_t GetChunkCapacity() const {
+        return _chunk_capacity;
+    }
+
+    std::size_t GetChunkCount() const {
+        return _chunks.size();
+    }
+
+    std::uint32_t GetEntityCount() const {
+        return _entity_count;
+    }
+
+    ArchetypeChunk &GetChunk(std::size_t chunk) {
+        return *_chunks[chunk];
+    }
+
+    bool HasComponent(Component id) const {
+        return _offsets[id] != NO_COLUMN;
+    }
+
+    void *GetComponent(std::uint32_t chunk, std::uint32_t row, Component id) {
+        assert(HasComponent(id) && "Archetype does not have this component");
+        return _chunks[chunk]->data + _offsets[id] + row * _infos[id]->size;
+    }
+
+    template<typename T>
+    T *GetColumn(std::size_t chunk, Component id) {
+        assert(HasComponent(id) && "Archetype does not have this component");
+        return reinterpret_cast<T *>(_chunks[chunk]->data + _offsets[id]);
+    }
+
+    const std::vector<Component> &GetComponentIDs() const {
+        return _component_ids;
+    }
+
+    // Reserves a row at the end. Components are left uninitialized
+    std::pair<std::uint32_t, std::uint32_t> Allocate(Entity entity) {
+        if (_chunks.empty() || _chunks.back()->count == _chunk_capacity)
+            _chunks.push_back(std::make_unique<ArchetypeChunk>(_chunk_size));
+
+        std::uint32_t chunk = _chunks.size() - 1;
+        std::uint32_t row = _chunks[chunk]->count++;
+        _chunks[chunk]->GetEntities()[row] = entity;
+        _entity_count++;
+
+        return { chunk, row };
+    }
+
+    // Destroys components in the row and fills it with the last row of the archetype
+    // Returns entity which has been moved into the row
+    Entity Remove(std::uint32_t chunk, std::uint32_t row) {
+        ArchetypeChunk &last_chunk = *_chunks.back();
+        std::uint32_t last_chunk_index = _chunks.size() - 1;
+        std::uint32_t last_row = last_chunk.count - 1;
+
+        for (Component id : _component_ids)
+            _infos[id]->destroy(GetComponent(chunk, row, id));
+
+        Entity moved = last_chunk.GetEntities()[last_row];
+        if (chunk != last_chunk_index || row != last_row) {
+            for (Component id : _component_ids) {
+                void *last = GetComponent(last_chunk_index, last_row, id);
+                _infos[id]->move_construct(GetComponent(chunk, row, id), last);
+                _infos[id]->destroy(last);
+            }
+            _chunks[chunk]->GetEntities()[row] = moved;
+        }
+
+        last_chunk.count--;
+        _entity_count--;
+        if (last_chunk.count == 0)
+            _chunks.pop_back();
+
+        return moved;
+    }
+
+    std::size_t GetMemoryUsage() const {
+        return sizeof(Archetype) + _chunks.size() * (sizeof(ArchetypeChunk) + _chunk_size);
+    }
+
+    ~Archetype() {
+        for (auto &chunk : _chunks)
+            for (std::uint32_t row = 0; row < chunk->count; row++)
+                for (Component id : _component_ids)
+                    _infos[id]->destroy(chunk->data + _offsets[id] + row * _infos[id]->size);
+    }
+
+private:
+    // Returns the bytes a chunk of _chunk_capacity rows needs
+    std::size_t LayoutColumns() {
+        std::size_t offset = sizeof(Entity) * _chunk_capacity;
+        for (Component id : _component_ids) {
+            std::size_t alignment = _infos[id]->alignment;
+            offset = (offset + alignment - 1) / alignment * alignment;
+            _offsets[id] = offset;
+            offset += _infos[id]->size * _chunk_capacity;
+        }
+        return offset;
+    }
+};
+
+// Component storage where entities with equal signatures live together in chunks,
+// one column per component. Alternative to a ComponentArray per component type
+class ArchetypeStorage {
+    struct EntityLocation {
+        Archetype *archetype = nullptr;
+        std::uint32_t chunk = 0;
+        std::uint32_t row = 0;
+    };
+
+    std::array<ComponentInfo, MAX_COMPONENTS> _infos;
+    std::vector<std::unique_ptr<Archetype>> _archetypes;
+    std::unordered_map<Signature, Archetype *> _signature_to_archetype;
+    std::vector<EntityLocation> _locations;
+
+public:
+    template<typename T>
+    void RegisterComponentType(Component id) {
+        assert(!_infos[id].IsValid() && "This component has been already registered");
+        _infos[id] = ComponentInfo::Of<T>();
+    }
+
+    bool IsRegistered(Component id) const {
+        return _infos[id].IsValid();
+    }
+
+    bool HasComponent(Entity entity, Component id) const {
+        EntityIndex index = GetEntityIndex(entity);
+        if (index >= _locations.size() || !_locations[index].archetype)
+            return false;
+        return _locations[index].archetype->HasComponent(id);
+    }
+
+    template<typename T>
+    T &Get(Entity entity, Component id) {
+        assert(HasComponent(entity, id) && "Entity does not have this component");
+        EntityLocation &location = _locations[GetEntityIndex(entity)];
+        return *static_cast<T *>(location.archetype->GetComponent(location.chunk, location.row, id));
+    }
+
+    template<typename T>
+    void Set(Entity entity, Component id, const T &component) {
+        Emplace<T>(entity, id, component);
+    }
+
+    // Constructs component in place, or replaces existing one. Aggregates are brace-initialized
+    template<typename T, typename ...Args>
+    T &Emplace(Entity entity, Component id, Args &&...args) {
+        if (HasComponent(entity, id)) {
+            T &component = Get<T>(entity, id);
+            if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::decay_t<Args>, T> && ...))
+                component = (std::forward<Args>(args), ...);
+            else if constexpr (std::is_constructible_v<T, Args &&...>)
+                component = T(std::forward<Args>(args)...);
+            else
+                component = T{ std::forward<Args>(args)... };
+            return component;
+        }
+
+        EntityLocation &location = GetLocation(entity);
+        Archetype *target = GetAddEdge(location.archetype, id);
+        MoveEntity(entity, target, id);
+
+        void *place = target->GetComponent(location.chunk, location.row, id);
+        if constexpr (std::is_constructible_v<T, Args &&...>)
+            return *new (place) T(std::forward<Args>(args)...);
+        else
+            return *new (place) T{ std::forward<Args>(args)... };
+    }
+
+    // Places an entity without components straight into its final archetype
+    template<typename ...Ts>
+    void Insert(Entity entity, const Signature &signature, const Ts &...components) {
+        assert((GetEntityIndex(entity) >= _locations.size() || !_locations[GetEntityIndex(entity)].archetype) &&
+            "Entity already has components");
+
+        Archetype *target = GetArchetype(signature);
+        auto [chunk, row] = target->Allocate(entity);
+        (new (target->GetComponent(chunk, row, component_type_id<std::remove_const_t<Ts>>)) std::remove_const_t<Ts>(components), ...);
+
+        EntityLocation &location = GetLocation(entity);
+        location.archetype = target;
+        location.chunk = chunk;
+        location.row = row;
+    }
+
+    void Remove(Entity entity, Component id) {
+        assert(HasComponent(entity, id) && "Entity does not have this component");
+
+        EntityLocation &location = _locations[GetEntityIndex(entity)];
+        Archetype *target = GetRemoveEdge(location.archetype, id);
+        MoveEntity(entity, target, id);
+    }
+
+    void RemoveEntity(Entity entity) {
+        EntityIndex index = GetEntityIndex(entity);
+        if (index >= _locations.size() || !_locations[index].archetype)
+            return;
+        EntityLocation &location = _locations[index];
+        Entity moved = location.archetype->Remove(location.chunk, location.row);
+        if (moved != entity)
+            _locations[GetEntityIndex(moved)] = location;
+        location = EntityLocation();
+    }
+
+    // Calls func(Entity, Ts&...) or func(Ts&...) for every entity having all of Ts, chunk by chunk
+    template<typename ...Ts, typename Func>
+    void ForEach(Func func) {
+        Signature required;
+        (required.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+
+        for (auto &archetype : _archetypes) {
+            if (!archetype->signature.IsSufficientFor(required))
+                continue;
+
+            for (std::size_t chunk = 0; chunk < archetype->GetChunkCount(); chunk++) {
+                ArchetypeChunk &data = archetype->GetChunk(chunk);
+                Entity *entities = data.GetEntities();
+                std::tuple<Ts *...> columns(archetype->GetColumn<Ts>(chunk, component_type_id<std::remove_const_t<Ts>>)...);
+
+                for (std::uint32_t row = 0; row < data.count; row++)
+                    InvokeWithEntity(func, entities[row], std::get<Ts *>(columns)[row]...);
+            }
+        }
+    }
+
+    // Chunks are distributed over the pool, entities of a chunk are processed by one worker
+    template<typename ...Ts, typename Func>
+    void ParallelForEach(ThreadPool *pool, Func func) {
+        if (!pool) {
+            ForEach<Ts...>(func);
+            return;
+        }
+
+        Signature required;
+        (required.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+
+        std::vector<std::pair<Archetype *, std::size_t>> chunks;
+        for (auto &archetype : _archetypes) {
+            if (!archetype->signature.IsSufficientFor(required))
+                continue;
+            for (std::size_t chunk = 0; chunk < archetype->GetChunkCount(); chunk++)
+                chunks.push_back({ archetype.get(), chunk });
+        }
+
+        pool->ParallelFor(chunks.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                auto [archetype, chunk] = chunks[i];
+                ArchetypeChunk &data = archetype->GetChunk(chunk);
+                Entity *entities = data.GetEntities();
+                std::tuple<Ts *...> columns(archetype->GetColumn<Ts>(chunk, component_type_id<std::remove_const_t<Ts>>)...);
+
+                for (std::uint32_t row = 0; row < data.count; row++)
+                    InvokeWithEntity(func, entities[row], std::get<Ts *>(columns)[row]...);
+            }
+        });
+    }
+
+    std::size_t GetArchetypeCount() const {
+        return _archetypes.size();
+    }
+
+    std::size_t GetMemoryUsage() const {
+        std::size_t result = sizeof(ArchetypeStorage) + _locations.capacity() * sizeof(EntityLocation);
+        for (auto &archetype : _archetypes)
+            result += archetype->GetMemoryUsage();
+        return result;
+    }
+
+private:
+    EntityLocation &GetLocation(Entity entity) {
+        EntityIndex index = GetEntityIndex(entity);
+        if (index >= _locations.size())
+            _locations.resize(index + 1);
+        return _locations[index];
+    }
+
+    Archetype *GetArchetype(const Signature &signature) {
+        auto it = _signature_to_archetype.find(signature);
+        if (it != _signature_to_archetype.end())
+            return it->second;
+
+        _archetypes.push_back(std::make_unique<Archetype>(signature, _infos));
+        Archetype *archetype = _archetypes.back().get();
+        _signature_to_archetype.insert({ signature, archetype });
+        return archetype;
+    }
+
+    Archetype *GetAddEdge(Archetype *source, Component id) {
+        if (source && source->add_edges[id])
+            return source->add_edges[id];
+
+        Signature signature = source ? source->signature : Signature();
+        signature.AddComponent(id);
+        Archetype *target = GetArchetype(signature);
+        if (source) {
+            source->add_edges[id] = target;
+            target->remove_edges[id] = source;
+        }
+        return target;
+    }
+
+    Archetype *GetRemoveEdge(Archetype *source, Component id) {
+        if (source->remove_edges[id])
+            return source->remove_edges[id];
+
+        Signature signature = source->signature;
+        signature.RemoveComponent(id);
+        if (signature.IsEmpty())
+            return nullptr;
+
+        Archetype *target = GetArchetype(signature);
+        source->remove_edges[id] = target;
+        target->add_edges[id] = source;
+        return target;
+    }
+
+    // Moves all components shared by the current and target archetypes.
+    // Component `changed` is left uninitialized in the target
+    void MoveEntity(Entity entity, Archetype *target, Component changed) {
+        EntityLocation &location = GetLocation(entity);
+        EntityLocation destination;
+        destination.archetype = target;
+
+        if (target) {
+            auto [chunk, row] = target->Allocate(entity);
+            destination.chunk = chunk;
+            destination.row = row;
+
+            if (location.archetype) {
+                for (Component id : target->GetComponentIDs()) {
+                    if (id == changed)
+                        continue;
+                    _infos[id].move_construct(
+                        target->GetComponent(chunk, row, id),
+                        location.archetype->GetComponent(location.chunk, location.row, id));
+                }
+            }
+        }
+
+        if (location.archetype) {
+            Entity moved = location.archetype->Remove(location.chunk, location.row);
+            if (moved != entity)
+                _locations[GetEntityIndex(moved)] = location;
+        }
+
+        location = destination;
+    }
+};
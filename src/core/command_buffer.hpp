@@ -0,0 +1,265 @@
+#pragma once
+
+#include "constants.hpp"
+#include "entity.hpp"
+#include "component.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class Engine;
+
+// Records structural changes to apply them later at a sync point, so they are safe to make
+// while iterating. Not thread-safe itself - use one buffer per thread.
+// Every command remembers the task which recorded it, see ThreadPool::GetTaskKey, so buffers
+// applied together give the same result however tasks were spread over threads
+class CommandBuffer {
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr EntityGeneration PENDING_GENERATION = ~0u;
+
+    enum class Kind : std::uint8_t {
+        Create,
+        Modify,
+        Delete,
+    };
+
+    struct Command {
+        Kind kind;
+        Component component;
+        std::uint32_t sequence;
+        std::uint64_t key;
+        Entity entity;
+        void *payload;
+        void (*apply)(void *engine, Entity entity, void *payload);
+        void (*destroy)(void *payload);
+    };
+
+    // Command of some buffer applied together with others, buffer breaks ties between equal keys
+    struct Entry {
+        Command *command;
+        CommandBuffer *buffer;
+        std::size_t buffer_index;
+    };
+
+    std::vector<Command> _commands;
+    // Entities created for pending handles, by pending index
+    std::vector<Entity> _created;
+    std::vector<std::unique_ptr<std::byte[]>> _blocks;
+    // Payloads larger than a block, freed by Clear
+    std::vector<std::unique_ptr<std::byte[]>> _large_payloads;
+    std::size_t _block;
+    std::size_t _block_offset;
+    std::uint32_t _pending_count;
+
+public:
+    CommandBuffer() : _block(0), _block_offset(0), _pending_count(0) {}
+
+    CommandBuffer(const CommandBuffer &) = delete;
+    CommandBuffer &operator=(const CommandBuffer &) = delete;
+
+    ~CommandBuffer() {
+        Clear();
+    }
+
+    // Returned handle is only valid for commands recorded into this buffer
+    Entity CreateEntity() {
+        Entity pending = MakeEntity(_pending_count++, PENDING_GENERATION);
+        Record({ Kind::Create, 0, 0, 0, pending, nullptr, nullptr, nullptr });
+        return pending;
+    }
+
+    void DeleteEntity(Entity entity) {
+        Record({ Kind::Delete, 0, 0, 0, entity, nullptr, nullptr, nullptr });
+    }
+
+    template<typename T>
+    void SetComponent(Entity entity, const T &component) {
+        void *payload = Allocate(sizeof(T), alignof(T));
+        new (payload) T(component);
+
+        Record({ Kind::Modify, component_type_id<T>, 0, 0, entity, payload,
+            [](void *engine, Entity target, void *data) {
+                ApplySet<Engine, T>(engine, target, data);
+            },
+            [](void *data) {
+                static_cast<T *>(data)->~T();
+            } });
+    }
+
+    template<typename T>
+    void RemoveComponent(Entity entity) {
+        Record({ Kind::Modify, component_type_id<T>, 0, 0, entity, nullptr,
+            [](void *engine, Entity target, void *) {
+                ApplyRemove<Engine, T>(engine, target);
+            },
+            nullptr });
+    }
+
+    bool IsEmpty() const {
+        return _commands.empty();
+    }
+
+    std::size_t GetSize() const {
+        return _commands.size();
+    }
+
+    // Applies this buffer alone, see ApplyAll
+    template<typename EngineT>
+    void Apply(EngineT &engine) {
+        CommandBuffer *buffers[] = { this };
+        ApplyAll(engine, buffers);
+    }
+
+    // Applies commands of all buffers as a single batch, ordered by the tasks which recorded them.
+    // Creations go first, then component changes grouped by component and entity, deletions last
+    // in one DeleteEntities call. Changes to the same component of the same entity keep their task order
+    template<typename EngineT, typename Buffers>
+    static void ApplyAll(EngineT &engine, Buffers &buffers) {
+        bool empty = true;
+        for (auto &buffer : buffers)
+            empty = empty && buffer->IsEmpty();
+        if (empty)
+            return;
+
+        // Reused between flushes, so steady frames do not allocate
+        static thread_local std::vector<Entry> entries;
+        static thread_local std::vector<Entity> deleted;
+
+        entries.clear();
+        std::size_t buffer_index = 0;
+        for (auto &buffer : buffers) {
+            for (Command &command : buffer->_commands) {
+                if (command.kind == Kind::Create)
+                    entries.push_back({ &command, &*buffer, buffer_index });
+            }
+            buffer->_created.resize(buffer->_pending_count);
+            buffer_index++;
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return IsRecordedBefore(a, b);
+        });
+        for (const Entry &entry : entries)
+            entry.buffer->_created[GetEntityIndex(entry.command->entity)] = engine.CreateEntity();
+
+        entries.clear();
+        buffer_index = 0;
+        for (auto &buffer : buffers) {
+            for (Command &command : buffer->_commands) {
+                if (command.kind == Kind::Create)
+                    continue;
+                if (GetEntityGeneration(command.entity) == PENDING_GENERATION)
+                    command.entity = buffer->_created[GetEntityIndex(command.entity)];
+                entries.push_back({ &command, &*buffer, buffer_index });
+            }
+            buffer_index++;
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            const Command &first = *a.command;
+            const Command &second = *b.command;
+            if (first.kind != second.kind)
+                return first.kind < second.kind;
+            if (first.component != second.component)
+                return first.component < second.component;
+            if (GetEntityIndex(first.entity) != GetEntityIndex(second.entity))
+                return GetEntityIndex(first.entity) < GetEntityIndex(second.entity);
+            return IsRecordedBefore(a, b);
+        });
+
+        deleted.clear();
+        for (const Entry &entry : entries) {
+            Command &command = *entry.command;
+            // Entity might have been deleted earlier in this frame
+            if (!engine.IsAlive(command.entity))
+                continue;
+
+            if (command.kind == Kind::Delete) {
+                // Sorted by entity, so repeated deletions are adjacent
+                if (deleted.empty() || deleted.back() != command.entity)
+                    deleted.push_back(command.entity);
+            } else {
+                command.apply(&engine, command.entity, command.payload);
+            }
+        }
+        if (!deleted.empty())
+            engine.DeleteEntities(Span<const Entity>(deleted.data(), deleted.size()));
+
+        for (auto &buffer : buffers)
+            buffer->Clear();
+    }
+
+    // Drops recorded commands without applying them
+    void Clear() {
+        for (auto &command : _commands) {
+            if (command.destroy)
+                command.destroy(command.payload);
+        }
+        _commands.clear();
+        _large_payloads.clear();
+        _block = 0;
+        _block_offset = 0;
+        _pending_count = 0;
+    }
+
+private:
+    void Record(Command command) {
+        command.sequence = _commands.size();
+        command.key = ThreadPool::GetTaskKey();
+        _commands.push_back(command);
+    }
+
+    static bool IsRecordedBefore(const Entry &a, const Entry &b) {
+        if (a.command->key != b.command->key)
+            return a.command->key < b.command->key;
+        if (a.buffer_index != b.buffer_index)
+            return a.buffer_index < b.buffer_index;
+        return a.command->sequence < b.command->sequence;
+    }
+
+    // Payloads live in blocks which are never reallocated, so objects are never moved bytewise
+    void *Allocate(std::size_t size, std::size_t alignment) {
+        if (size + alignment > BLOCK_SIZE) {
+            _large_payloads.push_back(std::make_unique<std::byte[]>(size + alignment));
+            void *pointer = _large_payloads.back().get();
+            std::size_t space = size + alignment;
+            return std::align(alignment, size, pointer, space);
+        }
+
+        // A fresh block always has room, so this ends at the latest after adding one
+        while (true) {
+            if (_block == _blocks.size())
+                _blocks.push_back(std::make_unique<std::byte[]>(BLOCK_SIZE));
+
+            std::uintptr_t base = reinterpret_cast<std::uintptr_t>(_blocks[_block].get());
+            std::size_t offset = (base + _block_offset + alignment - 1) / alignment * alignment - base;
+            if (offset + size <= BLOCK_SIZE) {
+                _block_offset = offset + size;
+                return _blocks[_block].get() + offset;
+            }
+
+            _block++;
+            _block_offset = 0;
+        }
+    }
+
+    // Templated on engine so they are only instantiated where Engine is complete
+    template<typename EngineT, typename T>
+    static void ApplySet(void *engine, Entity entity, void *payload) {
+        static_cast<EngineT *>(engine)->template EmplaceComponent<T>(entity, std::move(*static_cast<T *>(payload)));
+    }
+
+    template<typename EngineT, typename T>
+    static void ApplyRemove(void *engine, Entity entity) {
+        EngineT *target = static_cast<EngineT *>(engine);
+        if (target->GetSignature(entity).Has(component_type_id<T>))
+            target->template RemoveComponent<T>(entity);
+    }
+};
@@ -1,17 +1,190 @@
 #pragma once
 
 #include "constants.hpp"
-#include "packed_array.hpp"
+#include "storage.hpp"
 #include "entity.hpp"
+#include "span.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
 
 class IComponentArray {
 public:
     virtual void OnEntityDeletion(Entity entity) = 0;
+
+    // Every entity must have data in this array
+    virtual void OnEntitiesDeletion(Span<const Entity> entities) = 0;
+
+    // Keeps change ticks within reach of now, see ClampTick
+    virtual void ClampTicks(Tick now) = 0;
+
+    // Bytes of component data and bookkeeping, see PoolMemory
+    virtual PoolMemory GetPoolMemory() const = 0;
+
+    virtual ~IComponentArray() = default;
+};
+
+// Ticks at which every entity's component was added and last changed.
+// Keyed by entity index so storages can reorder data freely. Pages are allocated on first use
+// from the same resource as component data
+class ChangeTicks {
+    struct Stamp {
+        Tick added;
+        Tick changed;
+    };
+
+    static constexpr EntityIndex PAGE_BITS = 12;
+    static constexpr EntityIndex PAGE_SIZE = 1u << PAGE_BITS;
+
+    std::pmr::memory_resource *_resource;
+    std::pmr::vector<Stamp *> _pages;
+
+public:
+    explicit ChangeTicks(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : _resource(resource), _pages(resource) {}
+
+    ChangeTicks(const ChangeTicks &) = delete;
+    ChangeTicks &operator=(const ChangeTicks &) = delete;
+
+    ~ChangeTicks() {
+        for (Stamp *page : _pages) {
+            if (page)
+                _resource->deallocate(page, PAGE_SIZE * sizeof(Stamp), alignof(Stamp));
+        }
+    }
+
+    void MarkAdded(EntityIndex index, Tick tick) {
+        EntityIndex page = index >> PAGE_BITS;
+        if (page >= _pages.size())
+            _pages.resize(page + 1, nullptr);
+        if (!_pages[page]) {
+            _pages[page] = static_cast<Stamp *>(_resource->allocate(PAGE_SIZE * sizeof(Stamp), alignof(Stamp)));
+            std::uninitialized_fill_n(_pages[page], PAGE_SIZE, Stamp {});
+        }
+        _pages[page][index & (PAGE_SIZE - 1)] = { tick, tick };
+    }
+
+    // Never allocates, so safe to call concurrently for different entities
+    void MarkChanged(EntityIndex index, Tick tick) {
+        assert((index >> PAGE_BITS) < _pages.size() && _pages[index >> PAGE_BITS] && "Component has never been added");
+        _pages[index >> PAGE_BITS][index & (PAGE_SIZE - 1)].changed = tick;
+    }
+
+    Tick GetAddedTick(EntityIndex index) const {
+        const Stamp *stamp = Find(index);
+        return stamp ? stamp->added : 0;
+    }
+
+    Tick GetChangedTick(EntityIndex index) const {
+        const Stamp *stamp = Find(index);
+        return stamp ? stamp->changed : 0;
+    }
+
+    // Bytes of allocated pages and the page table
+    std::size_t GetMemory() const {
+        std::size_t pages = std::count_if(_pages.begin(), _pages.end(), [](const Stamp *page) { return page != nullptr; });
+        return _pages.capacity() * sizeof(Stamp *) + pages * PAGE_SIZE * sizeof(Stamp);
+    }
+
+    void Clamp(Tick now) {
+        for (Stamp *page : _pages) {
+            if (!page)
+                continue;
+            for (EntityIndex i = 0; i < PAGE_SIZE; i++) {
+                page[i].added = ClampTick(page[i].added, now);
+                page[i].changed = ClampTick(page[i].changed, now);
+            }
+        }
+    }
+
+private:
+    const Stamp *Find(EntityIndex index) const {
+        EntityIndex page = index >> PAGE_BITS;
+        if (page >= _pages.size() || !_pages[page])
+            return nullptr;
+        return &_pages[page][index & (PAGE_SIZE - 1)];
+    }
 };
 
+// Stands in for ChangeTicks of components which are not tracked. Stamping does nothing,
+// querying is rejected at compile time by the engine and views
+class NoChangeTicks {
+public:
+    explicit NoChangeTicks(std::pmr::memory_resource * = nullptr) {}
+
+    void MarkAdded(EntityIndex, Tick) {}
+
+    void MarkChanged(EntityIndex, Tick) {}
+
+    void Clamp(Tick) {}
+
+    std::size_t GetMemory() const {
+        return 0;
+    }
+};
+
+// Whether T's array keeps change ticks. Empty components have no data which could change,
+// so tags skip them by default. Component overrides it with a `static constexpr bool TRACK_CHANGES` member
+template<typename T, typename = void>
+struct ComponentTracksChanges : std::bool_constant<!std::is_empty_v<T>> {};
+
+template<typename T>
+struct ComponentTracksChanges<T, std::void_t<decltype(T::TRACK_CHANGES)>> : std::bool_constant<T::TRACK_CHANGES> {};
+
 template<typename T>
-class ComponentArray : public PackedArray<T, MAX_ENTITIES>, public IComponentArray {
+using ComponentTicks = std::conditional_t<ComponentTracksChanges<T>::value, ChangeTicks, NoChangeTicks>;
+
+// Underlying storage is picked by component's storage policy, see storage.hpp
+template<typename T>
+class ComponentArray : public ComponentStorage<T>, public IComponentArray {
+public:
+    ComponentTicks<T> ticks;
+
+    explicit ComponentArray(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : ComponentStorage<T>(resource), ticks(resource) {}
+
+    PoolMemory GetPoolMemory() const override {
+        PoolMemory memory = this->GetMemory();
+        std::size_t tick_bytes = ticks.GetMemory();
+        memory.reserved += tick_bytes;
+        memory.index += tick_bytes;
+        return memory;
+    }
+
+private:
     void OnEntityDeletion(Entity entity) override {
-        this->RemoveData(entity);
+        this->RemoveData(GetEntityIndex(entity));
+    }
+
+    void OnEntitiesDeletion(Span<const Entity> entities) override {
+        for (Entity entity : entities)
+            this->RemoveData(GetEntityIndex(entity));
+    }
+
+    void ClampTicks(Tick now) override {
+        ticks.Clamp(now);
     }
 };
+
+// Every component type gets its own id the first time it is mentioned.
+// Id is used directly as a bit in Signature and as an index into engine's component arrays
+inline Component next_component_type_id = 0;
+
+inline Component NextComponentTypeID() {
+    assert(next_component_type_id < MAX_COMPONENTS && "Too many component types, increase MAX_COMPONENTS");
+    return next_component_type_id++;
+}
+
+template<typename T>
+inline const Component component_type_id = NextComponentTypeID();
+
+// Signature of a type list, built once on first use
+template<typename ...Ts>
+const Signature &SignatureOf() {
+    static const Signature signature { component_type_id<std::remove_const_t<Ts>>... };
+    return signature;
+}
@@ -2,8 +2,42 @@
 #include <cstdint>
 
 using Component = std::uint16_t;
-constexpr Component MAX_COMPONENTS = 30;
-constexpr Component MAX_SYSTEMS = 30;
+// Width of Signature, every component and tag type takes an id below it
+#ifndef ECS_MAX_COMPONENTS
+#define ECS_MAX_COMPONENTS 256
+#endif
+constexpr Component MAX_COMPONENTS = ECS_MAX_COMPONENTS;
 
-using Entity = std::uint16_t;
-constexpr Entity MAX_ENTITIES = 5000;
+// Entity handle packs index (low half) and generation (high half)
+using Entity = std::uint64_t;
+using EntityIndex = std::uint32_t;
+using EntityGeneration = std::uint32_t;
+// Entity storage grows on demand, this is only the amount reserved up front
+constexpr EntityIndex DEFAULT_ENTITY_CAPACITY = 1024;
+
+// Engine's change counter, advanced every time a system finishes. Stamps start from 1.
+// It wraps around, so ticks are compared by distance, see IsNewerTick
+using Tick = std::uint32_t;
+constexpr Tick TICK_HALF_RANGE = Tick(1) << 31;
+// Engine clamps stamps older than MAX_TICK_AGE at least every TICK_CLAMP_INTERVAL ticks,
+// so any two ticks it holds are less than half the range apart
+constexpr Tick TICK_CLAMP_INTERVAL = Tick(1) << 28;
+constexpr Tick MAX_TICK_AGE = TICK_HALF_RANGE - 2 * TICK_CLAMP_INTERVAL;
+
+// tick is newer when it is less than half the range ahead of than
+constexpr bool IsNewerTick(Tick tick, Tick than) {
+    return Tick(tick - than - 1) < TICK_HALF_RANGE - 1;
+}
+
+// Moves tick which is older than MAX_TICK_AGE up to that age
+constexpr Tick ClampTick(Tick tick, Tick now) {
+    return Tick(now - tick) > MAX_TICK_AGE ? Tick(now - MAX_TICK_AGE) : tick;
+}
+
+// Engine drops cached query results no one asked for in this many frames, see Engine::GetQueryResult
+constexpr std::uint64_t QUERY_CACHE_IDLE_FRAMES = 64;
+
+// Store components grouped by entity signature in chunks instead of an array per component type
+#ifndef ARCHETYPE_STORAGE
+#define ARCHETYPE_STORAGE 0
+#endif
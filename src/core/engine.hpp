@@ -2,25 +2,44 @@
 
 #include "logger.hpp"
 #include "component.hpp"
+#include "archetype.hpp"
 #include "system.hpp"
+#include "scheduler.hpp"
+#include "command_buffer.hpp"
+#include "view.hpp"
+#include "group.hpp"
+#include "observer.hpp"
+#include "query.hpp"
 #include "entity.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
-#include <unordered_map>
+#include <functional>
 #include <utility>
 #include <chrono>
 #include <memory>
 #include <random>
+#include <type_traits>
+#include <unordered_map>
+
+// Condition of static_asserts which only fire when the enclosing template is instantiated
+template<typename ...>
+inline constexpr bool DEPENDENT_FALSE = false;
 
 class Engine {
 public:
     std::mt19937 rng;
 
-    Engine() {
-        _signatures = PackedArray<Signature, MAX_ENTITIES>();
-        _components = PackedArray<IComponentArray *, MAX_ENTITIES>();
-        _systems = PackedArray<System *, MAX_SYSTEMS>();
-        _name_to_component_index = std::unordered_map<std::string, Component>();
+    // Component pools are allocated from component_memory, which has to outlive the engine
+    Engine(EntityIndex entity_capacity = DEFAULT_ENTITY_CAPACITY,
+        std::pmr::memory_resource *component_memory = std::pmr::get_default_resource())
+        : _component_memory(component_memory) {
+        _signatures.Reserve(entity_capacity);
+        _generations.reserve(entity_capacity);
+        _command_buffers.push_back(std::make_unique<CommandBuffer>());
+        _frame_arenas.push_back(std::make_unique<FrameArena>());
         
 		_last_update = std::chrono::high_resolution_clock::now();
 
@@ -32,6 +51,9 @@ public:
         for (auto *system : _systems.entries) {
             delete system;
         }
+        for (auto *component_array : _components.entries) {
+            delete component_array;
+        }
     }
 
     float GetSimulationTime() {
@@ -39,38 +61,151 @@ public:
     }
 
     Entity CreateEntity() {
-        return _signatures.AddData(Signature());
+        return AllocateEntity(Signature());
+    }
+
+    // Creates count entities with the same components.
+    // Storage is reserved once and systems are matched once for the whole batch
+    template<typename ...Ts>
+    std::vector<Entity> CreateEntities(EntityIndex count, const Ts &...components) {
+        (VerifyComponentRegistration<Ts>(), ...);
+        Signature signature = ConstructSignature<Ts...>();
+
+        std::vector<Entity> entities;
+        entities.reserve(count);
+        _signatures.Reserve(_signatures.GetSize() + count);
+        for (EntityIndex i = 0; i < count; i++)
+            entities.push_back(AllocateEntity(signature));
+
+#if ARCHETYPE_STORAGE
+        for (Entity entity : entities)
+            _archetypes.Insert(entity, signature, components...);
+#else
+        (FillComponents(entities, components), ...);
+        EnterGroups(entities, signature);
+#endif
+
+        if (count == 0 || sizeof...(Ts) == 0)
+            return entities;
+
+        ((_observers.IsObserved(component_type_id<Ts>, ComponentEvent::Add)
+            ? _observers.Record(component_type_id<Ts>, ComponentEvent::Add, entities, signature) : void()), ...);
+
+        // Every entity has the same signature so one check decides for the whole batch
+        auto match = [&](SignatureRef &ref) {
+            if (!ref.system->IsEntityProccessed(entities.front(), ref.signature) &&
+                ref.system->Accepts(ref.signature, signature))
+                ref.system->AddEntities(entities, ref.signature, signature);
+        };
+        ((std::for_each(_component_to_signatures[component_type_id<Ts>].begin(), _component_to_signatures[component_type_id<Ts>].end(), match)), ...);
+        std::for_each(_empty_signatures.begin(), _empty_signatures.end(), match);
+
+        return entities;
+    }
+
+    // Handle stays valid until the entity is deleted, even if its index is reused later.
+    // Handles of another engine, or forged ones, are not alive either
+    bool IsAlive(Entity entity) const {
+        EntityIndex index = GetEntityIndex(entity);
+        return index < _generations.size() && _generations[index] == GetEntityGeneration(entity);
     }
 
+    // Only arrays and system signatures mentioning entity's components are visited
     void DeleteEntity(Entity entity) {
-        _signatures.RemoveData(entity);
+        assert(IsAlive(entity) && "Entity has already been deleted");
 
-        for (auto i = 0u; i < _components.GetSize(); i++) {
-            _components.entries[i]->OnEntityDeletion(entity);
+        EntityIndex index = GetEntityIndex(entity);
+        Signature signature = _signatures.GetData(index);
+        RecordRemoval(entity, signature);
+        LeaveGroups(index, signature);
+        ReleaseEntity(index);
+
+#if ARCHETYPE_STORAGE
+        _archetypes.RemoveEntity(entity);
+#endif
+
+        for (auto &ref : _empty_signatures) {
+            if (ref.system->IsEntityProccessed(entity, ref.signature))
+                ref.system->RemoveEntity(entity, ref.signature);
         }
 
-		for (auto i = 0u; i < _systems.size(); i++) {
-			auto system = _systems.entries[i];
-			for (auto j = 0u; j < system->GetSignatureCount(); j++) {
-				if (system->IsEntityProccessed(entity, j))
-					system->RemoveEntity(entity, j);
-			}
-		}
+        signature.ForEachComponent([&](Component id) {
+#if !ARCHETYPE_STORAGE
+            _components.GetData(id)->OnEntityDeletion(entity);
+#endif
+
+            for (auto &ref : _component_to_signatures[id]) {
+                if (ref.system->IsEntityProccessed(entity, ref.signature))
+                    ref.system->RemoveEntity(entity, ref.signature);
+            }
+        });
+    }
+
+    // Entities are grouped by component first,
+    // so every array and system signature is visited once for the whole batch
+    void DeleteEntities(Span<const Entity> entities) {
+        std::array<std::vector<Entity>, MAX_COMPONENTS> by_component;
+
+        for (Entity entity : entities) {
+            assert(IsAlive(entity) && "Entity has already been deleted");
+
+            EntityIndex index = GetEntityIndex(entity);
+            Signature &signature = _signatures.GetData(index);
+            signature.ForEachComponent([&](Component id) {
+                by_component[id].push_back(entity);
+            });
+            RecordRemoval(entity, signature);
+            LeaveGroups(index, signature);
+            ReleaseEntity(index);
+
+#if ARCHETYPE_STORAGE
+            _archetypes.RemoveEntity(entity);
+#endif
+        }
+
+        for (auto &ref : _empty_signatures) {
+            for (Entity entity : entities) {
+                if (ref.system->IsEntityProccessed(entity, ref.signature))
+                    ref.system->RemoveEntity(entity, ref.signature);
+            }
+        }
+
+        for (Component id = 0; id < MAX_COMPONENTS; id++) {
+            if (by_component[id].empty())
+                continue;
+
+#if !ARCHETYPE_STORAGE
+            _components.GetData(id)->OnEntitiesDeletion(by_component[id]);
+#endif
+
+            for (auto &ref : _component_to_signatures[id]) {
+                for (Entity entity : by_component[id]) {
+                    if (ref.system->IsEntityProccessed(entity, ref.signature))
+                        ref.system->RemoveEntity(entity, ref.signature);
+                }
+            }
+        }
     }
 
     Signature& GetSignature(Entity entity) {
-        return _signatures.GetData(entity);
+        assert(IsAlive(entity) && "Entity has been deleted");
+        return _signatures.GetData(GetEntityIndex(entity));
     }
 
     template<typename T>
     void RegisterComponentType() {
+        Component id = component_type_id<T>;
 
-        std::string type_name = typeid(T).name();
+#if ARCHETYPE_STORAGE
+        static_assert(!IS_PROXY_STORAGE<typename ComponentStoragePolicy<T>::type>,
+            "SoA storage is not available with ARCHETYPE_STORAGE, drop the component's StoragePolicy");
+        _archetypes.RegisterComponentType<T>(id);
+#else
+        assert(!_components.HasData(id) && "This component has been already registered");
 
-        assert(_name_to_component_index.find(type_name) == _name_to_component_index.end() && "This component has been already registered");
-
-        IComponentArray *component_array = new ComponentArray<T>();
-        _name_to_component_index.insert(make_pair(type_name, _components.AddData(component_array)));
+        IComponentArray *component_array = new ComponentArray<T>(_component_memory);
+        _components.SetData(id, component_array);
+#endif
     }
 
     template<typename ...Args>
@@ -78,69 +213,187 @@ public:
         (RegisterComponentType<Args>(), ...);
     }
 
+    // Returns T& or a proxy, depending on component's storage
     template<typename T>
-    T &AddComponent(Entity entity) {
-        SetComponent(entity, T());
-		return GetComponent<T>(entity);
+    decltype(auto) AddComponent(Entity entity) {
+        return EmplaceComponent<T>(entity);
     }
 
     template<typename T>
     void SetComponent(Entity entity, const T &component) {
+        EmplaceComponent<T>(entity, component);
+    }
+
+    template<typename T>
+    void SetComponent(Entity entity, T &&component) {
+        EmplaceComponent<std::decay_t<T>>(entity, std::forward<T>(component));
+    }
+
+    // Constructs component from args right in storage, or replaces the existing one
+    template<typename T, typename ...Args>
+    decltype(auto) EmplaceComponent(Entity entity, Args &&...args) {
         VerifyComponentRegistration<T>();
+        bool added = !GetSignature(entity).Has(component_type_id<T>);
 
+#if ARCHETYPE_STORAGE
+        T &component = _archetypes.Emplace<T>(entity, component_type_id<T>, std::forward<Args>(args)...);
+#else
         ComponentArray<T> &component_array = GetComponentArray<T>();
-        component_array.SetData(entity, component);
+        decltype(auto) component = component_array.EmplaceData(GetEntityIndex(entity), std::forward<Args>(args)...);
+        if (added)
+            component_array.ticks.MarkAdded(GetEntityIndex(entity), GetTick());
+        else
+            component_array.ticks.MarkChanged(GetEntityIndex(entity), GetTick());
+#endif
 
         Signature& signature = GetSignature(entity);
         signature.AddComponent(GetComponentID<T>());
+        if (added)
+            _structure_version++;
 
+        ComponentEvent event = added ? ComponentEvent::Add : ComponentEvent::Set;
+        // Replacing a component is allowed from parallel updates, so it goes into the worker's batch
+        if (_observers.IsObserved(component_type_id<T>, event))
+            _observers.Record(component_type_id<T>, event, entity, signature, GetWorkerSlot());
+        if (IGroup *group = _component_to_group[component_type_id<T>])
+            group->OnComponentAdded(GetEntityIndex(entity), signature);
 
-        for (auto i = 0u; i < _systems.GetSize(); i++) {
-            auto system = _systems.entries[i];
+        if (added)
+            MatchSystems(entity, signature, component_type_id<T>);
 
-            // We need to check for every signature system has
-            for (auto j = 0u; j < system->GetSignatureCount(); j++) {
-                // If it is not proccessed but is valid now
-                if (!system->IsEntityProccessed(entity, j) && 
-                    signature.IsSufficientFor( system->signatures[j] )) {
+#if !ARCHETYPE_STORAGE
+        // Owning group may have swapped the component to its front, so look it up again
+        if (_component_to_group[component_type_id<T>])
+            return component_array.GetData(GetEntityIndex(entity));
+#endif
+        return component;
+    }
 
-                    system->AddEntity(entity, j);
-                }
+    // Sets components[i] to entities[i] with storage reserved once
+    template<typename T>
+    void AddComponents(Span<const Entity> entities, Span<const T> components) {
+        assert(entities.size() == components.size() && "Every entity needs its own component");
+        VerifyComponentRegistration<T>();
+        Component id = component_type_id<T>;
+
+#if ARCHETYPE_STORAGE
+        for (std::size_t i = 0; i < entities.size(); i++)
+            _archetypes.Set(entities[i], id, components[i]);
+#else
+        ComponentArray<T> &component_array = GetComponentArray<T>();
+        component_array.Reserve(component_array.GetSize() + entities.size());
+        for (std::size_t i = 0; i < entities.size(); i++) {
+            EntityIndex index = GetEntityIndex(entities[i]);
+            if (GetSignature(entities[i]).Has(id))
+                component_array.ticks.MarkChanged(index, GetTick());
+            else
+                component_array.ticks.MarkAdded(index, GetTick());
+            component_array.SetData(index, components[i]);
+        }
+#endif
+
+        // Consecutive entities which had the same signature make the same transition,
+        // so observers, the owning group and systems are updated once per run
+        for (std::size_t begin = 0; begin < entities.size();) {
+            Signature before = GetSignature(entities[begin]);
+            Signature after = before;
+            after.AddComponent(id);
+
+            // Signatures are updated while the run grows, so an entity listed twice ends it
+            std::size_t end = begin;
+            while (end < entities.size() && GetSignature(entities[end]) == before) {
+                GetSignature(entities[end]).AddComponent(id);
+                end++;
             }
+            Span<const Entity> run(entities.data() + begin, end - begin);
+            begin = end;
+
+            bool added = !before.Has(id);
+            ComponentEvent event = added ? ComponentEvent::Add : ComponentEvent::Set;
+            if (_observers.IsObserved(id, event))
+                _observers.Record(id, event, run, after);
+            if (!added)
+                continue;
+
+            _structure_version++;
+            if (IGroup *group = _component_to_group[id])
+                group->OnComponentsAdded(run, after);
+            MatchSystems(run, after, id);
         }
     }
 
     template<typename T>
     void RemoveComponent(Entity entity) {
+        assert(IsAlive(entity) && "Entity has been deleted");
         VerifyComponentRegistration<T>();
+        // Release builds ignore the call rather than report a removal which did not happen
+        bool has = GetSignature(entity).Has(component_type_id<T>);
+        assert(has && "Entity does not have this component");
+        if (!has)
+            return;
 
-        ComponentArray<T> component_array = GetComponentArray<T>();
-        component_array.RemoveData(entity);
+        if (_observers.IsObserved(component_type_id<T>, ComponentEvent::Remove))
+            _observers.Record(component_type_id<T>, ComponentEvent::Remove, entity, GetSignature(entity));
+
+#if ARCHETYPE_STORAGE
+        _archetypes.Remove(entity, component_type_id<T>);
+#else
+        if (IGroup *group = _component_to_group[component_type_id<T>])
+            group->OnComponentRemoving(GetEntityIndex(entity));
+
+        ComponentArray<T> &component_array = GetComponentArray<T>();
+        component_array.RemoveData(GetEntityIndex(entity));
+#endif
 
         Signature &signature = GetSignature(entity);
         signature.RemoveComponent(GetComponentID<T>());
+        _structure_version++;
 
-        for (auto i = 0u; i < _systems.GetSize(); ++i) {
-            System *system = _systems.entries[i];
-
-            // We need to check for every signature system has
-            for (auto j = 0u; j < system->GetSignatureCount(); ++j) {
+        MatchSystems(entity, signature, component_type_id<T>);
+    }
 
-                // If it is proccessed but not valid now - remove
-                if (system->IsEntityProccessed(entity, j) && 
-                    !signature.IsSufficientFor( system->signatures[j] )) {
+    // Mutable access. Does not stamp the component as changed, so systems which only declared
+    // Reads<T> can call it concurrently. Writers call MarkChanged, or iterate a mutable view
+    template<typename T>
+    decltype(auto) GetComponent(Entity entity) {
+        assert(IsAlive(entity) && "Entity has been deleted");
+#if ARCHETYPE_STORAGE
+        VerifyComponentRegistration<T>();
+        return _archetypes.Get<T>(entity, component_type_id<T>);
+#else
+        return GetComponentArray<T>().GetData(GetEntityIndex(entity));
+#endif
+    }
 
-                    system->RemoveEntity(entity, j);
-                }
-            }
-        }
+    // Same as GetComponent with const access. SoA components are gathered from their columns
+    // into a copy, as their proxies write through even when const
+    template<typename T>
+    decltype(auto) ReadComponent(Entity entity) {
+        assert(IsAlive(entity) && "Entity has been deleted");
+#if ARCHETYPE_STORAGE
+        VerifyComponentRegistration<T>();
+        return std::as_const(_archetypes.Get<T>(entity, component_type_id<T>));
+#else
+        decltype(auto) data = GetComponentArray<T>().GetData(GetEntityIndex(entity));
+        if constexpr (std::is_reference_v<decltype(data)>)
+            return std::as_const(data);
+        else
+            return static_cast<T>(data);
+#endif
     }
 
+    // Callback gets entities which had T added, removed or set since the last delivery of the phase.
+    // Only entities whose signature contains filter are reported
     template<typename T>
-    T &GetComponent(Entity entity) {
-        ComponentArray<T> &component_array = GetComponentArray<T>();
+    void Observe(ComponentEvent event, ObserverRegistry::Callback callback,
+                 ObserverPhase phase = ObserverPhase::FrameEnd, const Signature &filter = Signature()) {
+        VerifyComponentRegistration<T>();
+        _observers.Add(component_type_id<T>, event, phase, filter, std::move(callback));
+    }
 
-        return component_array.GetData(entity);
+    // Update does this on its own, only needed for changes made outside of it
+    void DeliverEvents(ObserverPhase phase) {
+        _observers.Deliver(phase);
     }
 
     template<typename T>
@@ -148,9 +401,20 @@ public:
         std::vector<T *> result;
         result.reserve(entities.size());
 
-		ComponentArray<T> &component_array = GetComponentArray<T>();
         for (Entity entity : entities)
-            result.push_back(&component_array.GetData(entity));
+            result.push_back(&GetComponent<T>(entity));
+
+        return result;
+    }
+
+    // Same as above with the list allocated from memory, e.g. GetFrameArena()
+    template<typename T>
+    std::pmr::vector<T *> GetComponentList(Span<const Entity> entities, std::pmr::memory_resource *memory) {
+        std::pmr::vector<T *> result(memory);
+        result.reserve(entities.size());
+
+        for (Entity entity : entities)
+            result.push_back(&GetComponent<T>(entity));
 
         return result;
     }
@@ -159,46 +423,267 @@ public:
 	T &RegisterSystem(Args... args) {
 		T *system = new T(*this, args...);
 
+        Scheduler &scheduler = system->per_frame ? _frame_scheduler : _scheduler;
+        if (system->stagger)
+            system->run_phase = scheduler.GetStaggeredPhase(*system);
+
         _systems.AddData(system);
+        scheduler.AddSystem(system);
+        AttachSystem(*system);
+
+		return *system;
+	}
+
+    // Keeps targets of a system the engine neither owns nor runs, e.g. one stored in a Pipeline.
+    // It has to be detached before it is destroyed
+    void AttachSystem(System &attached) {
+        System *system = &attached;
+        _attached_systems.push_back(system);
+        for (auto j = 0u; j < system->GetSignatureCount(); j++) {
+            Signature &signature = system->signatures[j];
+            // Empty signature accepts any entity with components
+            if (signature.IsEmpty())
+                _empty_signatures.push_back({ system, j });
+
+            signature.ForEachComponent([&](Component id) {
+                _component_to_signatures[id].push_back({ system, j });
+            });
+            system->exclusions[j].ForEachComponent([&](Component id) {
+                _component_to_exclusions[id].push_back({ system, j });
+            });
+            system->optionals[j].ForEachComponent([&](Component id) {
+                _component_to_optionals[id].push_back({ system, j });
+            });
+        }
 
         // For every entity check if it is required by the system
         for (auto i = 0u; i < GetEntityCount(); i++) {
             for (auto j = 0u; j < system->GetSignatureCount(); j++) {
-                if (_signatures.entries[i].IsSufficientFor(system->signatures[j])) {
-                    system->AddEntity(i, j);
+                if (system->Accepts(j, _signatures.entries[i])) {
+                    EntityIndex index = _signatures.GetEntry(i);
+                    system->AddEntity(MakeEntity(index, _generations[index]), j, _signatures.entries[i]);
                 }
             }
         }
+    }
 
-		return *system;
-	}
+    void DetachSystem(System &system) {
+        auto detach = [&](std::vector<SignatureRef> &refs) {
+            refs.erase(std::remove_if(refs.begin(), refs.end(),
+                [&](const SignatureRef &ref) { return ref.system == &system; }), refs.end());
+        };
+
+        _attached_systems.erase(std::remove(_attached_systems.begin(), _attached_systems.end(), &system), _attached_systems.end());
+        detach(_empty_signatures);
+        for (Component id = 0; id < MAX_COMPONENTS; id++) {
+            detach(_component_to_signatures[id]);
+            detach(_component_to_exclusions[id]);
+            detach(_component_to_optionals[id]);
+        }
+    }
 
     template<typename ...Args>
     void RegisterSystems() {
         (RegisterSystem<Args>(), ...);
     }
 
-    Entity GetEntityCount() const {
+    // Current tick, components changed or added from now on are stamped with it
+    Tick GetTick() const {
+        return _tick.load(std::memory_order_relaxed);
+    }
+
+    // Called every time a system finishes, so later changes are newer than its own
+    Tick AdvanceTick() {
+        return _tick.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+#if !ARCHETYPE_STORAGE
+    // Stamps entity's T as changed at the current tick. Caller must have declared Writes<T>
+    template<typename T>
+    void MarkChanged(Entity entity) {
+        assert(IsAlive(entity) && "Entity has been deleted");
+        static_assert(ComponentTracksChanges<T>::value, "Component does not track changes, see ComponentTracksChanges");
+        GetComponentArray<T>().ticks.MarkChanged(GetEntityIndex(entity), GetTick());
+    }
+
+    template<typename T>
+    bool IsChangedSince(Entity entity, Tick tick) {
+        assert(IsAlive(entity) && "Entity has been deleted");
+        static_assert(ComponentTracksChanges<T>::value, "Component does not track changes, see ComponentTracksChanges");
+        return IsNewerTick(GetComponentArray<T>().ticks.GetChangedTick(GetEntityIndex(entity)), tick);
+    }
+
+    template<typename T>
+    bool IsAddedSince(Entity entity, Tick tick) {
+        assert(IsAlive(entity) && "Entity has been deleted");
+        static_assert(ComponentTracksChanges<T>::value, "Component does not track changes, see ComponentTracksChanges");
+        return IsNewerTick(GetComponentArray<T>().ticks.GetAddedTick(GetEntityIndex(entity)), tick);
+    }
+#else
+    // Archetypes do not track change ticks yet
+    template<typename T>
+    void MarkChanged(Entity) {
+        static_assert(DEPENDENT_FALSE<T>, "Change ticks are not tracked with ARCHETYPE_STORAGE");
+    }
+
+    template<typename T>
+    bool IsChangedSince(Entity, Tick) {
+        static_assert(DEPENDENT_FALSE<T>, "Change ticks are not tracked with ARCHETYPE_STORAGE");
+        return true;
+    }
+
+    template<typename T>
+    bool IsAddedSince(Entity, Tick) {
+        static_assert(DEPENDENT_FALSE<T>, "Change ticks are not tracked with ARCHETYPE_STORAGE");
+        return true;
+    }
+#endif
+
+    EntityIndex GetEntityCount() const {
         return _signatures.GetSize();
     }
 
+    // Appends every entity matching query to result. Scans the packed signature array in blocks,
+    // see QueryScan, so cost depends on the amount of entities, not on which components they have
+    void QueryEntities(const Query &query, std::vector<Entity> &result) const {
+        const Signature *signatures = _signatures.entries.data();
+        EntityIndex size = _signatures.GetSize();
+        QueryScan scan(query);
+        for (EntityIndex block = 0; block < size; block += QueryScan::BLOCK_SIZE) {
+            std::uint64_t matches = scan.MatchBlock(signatures + block, std::min<EntityIndex>(QueryScan::BLOCK_SIZE, size - block));
+            while (matches) {
+                EntityIndex index = _signatures.GetEntry(block + __builtin_ctzll(matches));
+                matches &= matches - 1;
+                result.push_back(MakeEntity(index, _generations[index]));
+            }
+        }
+    }
+
+    // Same entities as QueryEntities, rescanned only when some entity was created or deleted,
+    // or gained or lost a component since the previous call. Valid until then, or until the end
+    // of the frame after QUERY_CACHE_IDLE_FRAMES frames without a call, when the result is dropped
+    Span<const Entity> GetQueryResult(const Query &query) {
+        CachedQuery &cached = _query_cache[query];
+        cached.used_frame = _frame;
+        if (cached.version != _structure_version) {
+            cached.entities.clear();
+            QueryEntities(query, cached.entities);
+            cached.version = _structure_version;
+        }
+        return cached.entities;
+    }
+
+    // Drops the cached result of a query which is not going to be asked for again
+    void ReleaseQuery(const Query &query) {
+        _query_cache.erase(query);
+    }
+
+    std::size_t GetCachedQueryCount() const {
+        return _query_cache.size();
+    }
+
     void Update() {
         auto now = std::chrono::high_resolution_clock::now();
-        dt = std::chrono::duration<float>(now - _last_update).count();
+        float dt = std::chrono::duration<float>(now - _last_update).count();
         _last_update = now;
 
-        _time += dt;
-
-        for (auto i = 0u; i < _systems.GetSize(); ++i) {
-            _systems.entries[i]->Update(dt);
-        }
+        Update(dt);
+    }
 
+    // Advances simulation by dt: a single step of dt, or as many fixed steps as have accumulated.
+    // Per frame systems run once afterwards
     void Update(float dt) {
-        _time += dt;
+        RunFrame(dt, [this](float step_dt) {
+            _scheduler.Run(step_dt, _step, _thread_pool.get(), [this]() { SyncPoint(); });
+        });
+    }
 
-        for (auto i = 0u; i < _systems.GetSize(); i++) {
-            _systems.entries[i]->Update(dt);
-        }
+    // Runs systems of the pipeline in their order, then the registered ones, on every step
+    template<typename StaticPipeline>
+    void Update(float dt, StaticPipeline &pipeline) {
+        RunFrame(dt, [this, &pipeline](float step_dt) {
+            pipeline.Run(step_dt, [this]() { SyncPoint(); });
+            _scheduler.Run(step_dt, _step, _thread_pool.get(), [this]() { SyncPoint(); });
+        });
+    }
+
+    // Simulation advances in steps of exactly step seconds, decoupled from the rate of Update.
+    // At most max_steps run per Update, the rest of a long frame is dropped to avoid a spiral of death.
+    // Zero step returns to a single step of the frame's dt
+    void SetFixedTimestep(float step, unsigned int max_steps = 8) {
+        assert(step >= 0 && max_steps > 0 && "Invalid fixed timestep");
+        _fixed_step = step;
+        _max_steps = max_steps;
+        _accumulator = 0;
+    }
+
+    // How far between the last two simulation steps the current frame is, in [0, 1).
+    // Per frame systems blend previous and current state with it. 1 without a fixed timestep
+    float GetInterpolationAlpha() const {
+        return _fixed_step > 0 ? _accumulator / _fixed_step : 1.0f;
+    }
+
+    // Amount of simulation steps taken so far
+    std::uint64_t GetStep() const {
+        return _step;
+    }
+
+    // Called at the start of every simulation step with its dt, e.g. to keep state for interpolation
+    void OnStep(std::function<void(float)> callback) {
+        _step_callbacks.push_back(std::move(callback));
+    }
+
+    // Systems which declared non-conflicting reads and writes will run concurrently.
+    // They must not create or delete entities or components during Update
+    void EnableParallelUpdate(unsigned int thread_count = std::thread::hardware_concurrency()) {
+        FlushCommands();
+        _thread_pool = std::make_unique<ThreadPool>(thread_count);
+        while (_command_buffers.size() < _thread_pool->GetThreadCount() + 1)
+            _command_buffers.push_back(std::make_unique<CommandBuffer>());
+        while (_frame_arenas.size() < _thread_pool->GetThreadCount() + 1)
+            _frame_arenas.push_back(std::make_unique<FrameArena>());
+        _observers.SetWorkerCount(_thread_pool->GetThreadCount() + 1);
+    }
+
+    void DisableParallelUpdate() {
+        FlushCommands();
+        _thread_pool.reset();
+    }
+
+    // Buffer of the calling thread. Recorded changes are applied after the current system
+    // finishes, or after all systems when updating in parallel
+    CommandBuffer &GetCommandBuffer() {
+        return *_command_buffers[GetWorkerSlot()];
+    }
+
+    // Scratch memory of the calling thread, valid until the next Update starts.
+    // Use with std::pmr containers, e.g. std::pmr::vector<T> list(&engine.GetFrameArena())
+    FrameArena &GetFrameArena() {
+        return *_frame_arenas[GetWorkerSlot()];
+    }
+
+    // Once frames reached their steady size: a frame which grows frame arenas asserts in debug builds.
+    // With ECS_COUNT_ALLOCATIONS so does any heap allocation on any thread, see GetHeapAllocationCount
+    void LockFrameMemory(bool locked = true) {
+        _frame_memory_locked = locked;
+        for (auto &arena : _frame_arenas)
+            arena->LockCapacity(locked);
+    }
+
+    // Buffers of all threads are applied as one batch, in an order independent of thread timing
+    void FlushCommands() {
+        CommandBuffer::ApplyAll(*this, _command_buffers);
+    }
+
+    // nullptr unless parallel update is enabled
+    ThreadPool *GetThreadPool() {
+        return _thread_pool.get();
+    }
+
+    // Logs system dependency graph and time each system took last update
+    void DumpSchedule() const {
+        _scheduler.Dump();
+        _frame_scheduler.Dump();
     }
 
     void RunForSeconds(double duration, float dt=-1.0f) {
@@ -215,37 +700,385 @@ public:
     template<typename T> 
     Component GetComponentID() {
         VerifyComponentRegistration<T>();
-        std::string type_name = typeid(T).name();
-
-        return _name_to_component_index.find(type_name)->second;
+        return component_type_id<T>;
     }
 
     template<typename ...Params>
     Signature ConstructSignature(){ 
-        Signature signature;
-        (signature.AddComponent(GetComponentID<Params>()), ...);
-        return signature;
+        (VerifyComponentRegistration<Params>(), ...);
+        return SignatureOf<Params...>();
+    }
+
+#if ARCHETYPE_STORAGE
+    ArchetypeStorage &GetArchetypeStorage() {
+        return _archetypes;
     }
 
+    // APIs below need a component array per type. They are declared anyway
+    // so using them fails to compile with the reason rather than with a missing member
+
+    template<typename T>
+    void GetComponentArray() {
+        static_assert(DEPENDENT_FALSE<T>, "Component arrays are not available with ARCHETYPE_STORAGE");
+    }
+
+    template<typename ...Ts>
+    PoolMemory GetPoolMemory() {
+        static_assert(DEPENDENT_FALSE<Ts...>, "Pool memory is not reported with ARCHETYPE_STORAGE, see ArchetypeStorage::GetMemoryUsage");
+        return {};
+    }
+
+    template<typename ...Ts>
+    void GetView() {
+        static_assert(DEPENDENT_FALSE<Ts...>, "Views are not available with ARCHETYPE_STORAGE, use ForEach");
+    }
+
+    template<typename ...Ts>
+    void CreateGroup() {
+        static_assert(DEPENDENT_FALSE<Ts...>, "Groups are not available with ARCHETYPE_STORAGE, archetypes already keep components together");
+    }
+#else
     template<typename T>
     ComponentArray<T> &GetComponentArray() {
         IComponentArray *&base_array = _components.GetData(GetComponentID<T>());
         return static_cast<ComponentArray<T>&>(*base_array);
     }
 
+    // Reserved and used bytes of T's pool
+    template<typename T>
+    PoolMemory GetPoolMemory() {
+        return GetComponentArray<T>().GetPoolMemory();
+    }
+
+    // Totals over every registered pool
+    PoolMemory GetPoolMemory() const {
+        PoolMemory memory;
+        for (const IComponentArray *component_array : _components.entries)
+            memory += component_array->GetPoolMemory();
+        return memory;
+    }
+
+    template<typename ...Ts>
+    View<Ts...> GetView() {
+        return View<Ts...>(_signatures, _generations, GetTick(), GetComponentArray<std::remove_const_t<Ts>>()...);
+    }
+
+    // Group takes ownership of order of Ts arrays and keeps entities having all of Ts
+    // packed at their front. Each component type can be owned by one group, so groups are
+    // left to the application: library systems never create them over shared components.
+    // Adding or removing an owned component reorders its array, references into it do not survive that
+    template<typename ...Ts>
+    Group<Ts...> &CreateGroup() {
+        (VerifyComponentRegistration<Ts>(), ...);
+        assert((!_component_to_group[component_type_id<Ts>] && ...) && "Component is already owned by a group");
+
+        auto group = std::make_unique<Group<Ts...>>(_generations, _tick, GetComponentArray<Ts>()...);
+        Group<Ts...> &result = *group;
+        ((_component_to_group[component_type_id<Ts>] = group.get()), ...);
+        _groups.push_back(std::move(group));
+        return result;
+    }
+#endif
+
+    // Calls func(Entity, Ts&...) or func(Ts&...) for every entity having all of Ts
+    template<typename ...Ts, typename Func>
+    void ForEach(Func func) {
+#if ARCHETYPE_STORAGE
+        (VerifyComponentRegistration<Ts>(), ...);
+        _archetypes.ForEach<Ts...>(func);
+#else
+        GetView<Ts...>().ForEach(func);
+#endif
+    }
+
+    // Same as ForEach but spread over the thread pool when parallel update is enabled
+    template<typename ...Ts, typename Func>
+    void ParallelForEach(Func func) {
+#if ARCHETYPE_STORAGE
+        (VerifyComponentRegistration<Ts>(), ...);
+        _archetypes.ParallelForEach<Ts...>(GetThreadPool(), func);
+#else
+        GetView<Ts...>().ParallelForEach(GetThreadPool(), func);
+#endif
+    }
+
 private:	
-    PackedArray<Signature, MAX_ENTITIES> _signatures;
-    PackedArray<IComponentArray *, MAX_ENTITIES> _components;
-    PackedArray<System *, MAX_SYSTEMS> _systems;
-    std::unordered_map<std::string, Component> _name_to_component_index;
+    struct SignatureRef {
+        System *system;
+        unsigned int signature;
+    };
+
+    struct CachedQuery {
+        std::uint64_t version = 0;
+        std::uint64_t used_frame = 0;
+        std::vector<Entity> entities;
+    };
 
+    PackedArray<Signature> _signatures;
+    PackedArray<IComponentArray *> _components;
+    PackedArray<System *> _systems;
+    // Every system keeping targets, owned by the engine or not
+    std::vector<System *> _attached_systems;
+    std::vector<EntityGeneration> _generations;
+    std::vector<EntityIndex> _free_indices;
+    // For every component - system signatures which require it
+    std::array<std::vector<SignatureRef>, MAX_COMPONENTS> _component_to_signatures;
+    // System signatures which exclude each component, or have it as optional
+    std::array<std::vector<SignatureRef>, MAX_COMPONENTS> _component_to_exclusions;
+    std::array<std::vector<SignatureRef>, MAX_COMPONENTS> _component_to_optionals;
+    std::vector<SignatureRef> _empty_signatures;
+    std::vector<std::unique_ptr<IGroup>> _groups;
+    // Group owning each component, if any
+    std::array<IGroup *, MAX_COMPONENTS> _component_to_group {};
+    Scheduler _scheduler;
+    // Systems running once per Update rather than on every simulation step
+    Scheduler _frame_scheduler;
+    std::vector<std::function<void(float)>> _step_callbacks;
+    float _fixed_step = 0;
+    unsigned int _max_steps = 8;
+    float _accumulator = 0;
+    std::uint64_t _step = 0;
+    std::uint64_t _frame = 0;
+    ObserverRegistry _observers;
+    std::unique_ptr<ThreadPool> _thread_pool;
+    std::vector<std::unique_ptr<CommandBuffer>> _command_buffers;
+    // Per thread, like command buffers
+    std::vector<std::unique_ptr<FrameArena>> _frame_arenas;
+    bool _frame_memory_locked = false;
+#if ARCHETYPE_STORAGE
+    ArchetypeStorage _archetypes;
+#endif
+
+    std::unordered_map<Query, CachedQuery> _query_cache;
+    // Advanced on every change of any signature, starts from 1 so fresh cache entries are stale
+    std::uint64_t _structure_version = 1;
+    std::pmr::memory_resource *_component_memory;
+    std::atomic<Tick> _tick { 1 };
+    Tick _ticks_clamped_at = 1;
     float _time = 0;
     std::chrono::time_point<std::chrono::high_resolution_clock> _last_update;
 
+    Entity AllocateEntity(const Signature &signature) {
+        EntityIndex index;
+        if (_free_indices.empty()) {
+            index = _generations.size();
+            _generations.push_back(0);
+        } else {
+            index = _free_indices.back();
+            _free_indices.pop_back();
+        }
+
+        _signatures.SetData(index, signature);
+        _structure_version++;
+        return MakeEntity(index, _generations[index]);
+    }
+
+    template<typename Simulate>
+    void RunFrame(float dt, Simulate simulate) {
+#if ECS_COUNT_ALLOCATIONS
+        std::size_t heap_allocations = GetHeapAllocationCount();
+#endif
+        for (auto &arena : _frame_arenas)
+            arena->Reset();
+        if (Tick(GetTick() - _ticks_clamped_at) >= TICK_CLAMP_INTERVAL)
+            ClampTicks();
+
+        if (_fixed_step > 0) {
+            _accumulator = std::min(_accumulator + dt, _fixed_step * _max_steps);
+            while (_accumulator >= _fixed_step) {
+                RunStep(_fixed_step, simulate);
+                _accumulator -= _fixed_step;
+            }
+        } else {
+            RunStep(dt, simulate);
+        }
+
+        _frame_scheduler.Run(dt, _frame, _thread_pool.get(), [this]() { SyncPoint(); });
+        _frame++;
+        _observers.Deliver(ObserverPhase::FrameEnd);
+        if (_frame % QUERY_CACHE_IDLE_FRAMES == 0)
+            EvictIdleQueries();
+
+#if ECS_COUNT_ALLOCATIONS
+        assert((!_frame_memory_locked || GetHeapAllocationCount() == heap_allocations) &&
+            "Frame allocated from the heap while frame memory is locked");
+        (void)heap_allocations;
+#endif
+    }
+
+    template<typename Simulate>
+    void RunStep(float dt, Simulate &simulate) {
+        for (auto &callback : _step_callbacks)
+            callback(dt);
+        simulate(dt);
+        _time += dt;
+        _step++;
+    }
+
+    void EvictIdleQueries() {
+        for (auto it = _query_cache.begin(); it != _query_cache.end();) {
+            if (_frame - it->second.used_frame > QUERY_CACHE_IDLE_FRAMES)
+                it = _query_cache.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // Stamps older than MAX_TICK_AGE are moved up to it, so they never look newer after the tick wraps
+    void ClampTicks() {
+        Tick now = GetTick();
+#if !ARCHETYPE_STORAGE
+        for (IComponentArray *component_array : _components.entries)
+            component_array->ClampTicks(now);
+#endif
+        for (System *system : _attached_systems)
+            system->ClampTicks(now);
+        _ticks_clamped_at = now;
+    }
+
+    // Slot of the calling thread in per-worker state: command buffers, frame arenas and observer batches
+    std::size_t GetWorkerSlot() const {
+        return _thread_pool ? _thread_pool->GetWorkerIndex() : 0;
+    }
+
+    void SyncPoint() {
+        FlushCommands();
+        _observers.Deliver(ObserverPhase::SyncPoint);
+    }
+
+    // Brings system targets up to date after entity gained or lost component id.
+    // Only signatures which mention the component are checked
+    void MatchSystems(Entity entity, const Signature &signature, Component id) {
+        auto match = [&](SignatureRef &ref) {
+            bool processed = ref.system->IsEntityProccessed(entity, ref.signature);
+            bool accepted = ref.system->Accepts(ref.signature, signature);
+            if (!processed && accepted)
+                ref.system->AddEntity(entity, ref.signature, signature);
+            else if (processed && !accepted)
+                ref.system->RemoveEntity(entity, ref.signature);
+            else if (processed)
+                ref.system->UpdateSplit(entity, ref.signature, signature);
+        };
+
+        std::for_each(_component_to_signatures[id].begin(), _component_to_signatures[id].end(), match);
+        std::for_each(_component_to_exclusions[id].begin(), _component_to_exclusions[id].end(), match);
+        std::for_each(_component_to_optionals[id].begin(), _component_to_optionals[id].end(), match);
+        // Empty signatures accept any entity with components, removals do not concern them
+        if (signature.Has(id))
+            std::for_each(_empty_signatures.begin(), _empty_signatures.end(), match);
+    }
+
+    // Same for entities which had equal signatures before gaining component id,
+    // so one check decides for the whole batch
+    void MatchSystems(Span<const Entity> entities, const Signature &signature, Component id) {
+        auto match = [&](SignatureRef &ref) {
+            bool processed = ref.system->IsEntityProccessed(entities[0], ref.signature);
+            bool accepted = ref.system->Accepts(ref.signature, signature);
+            if (!processed && accepted) {
+                ref.system->AddEntities(entities, ref.signature, signature);
+            } else if (processed && !accepted) {
+                for (Entity entity : entities)
+                    ref.system->RemoveEntity(entity, ref.signature);
+            } else if (processed) {
+                for (Entity entity : entities)
+                    ref.system->UpdateSplit(entity, ref.signature, signature);
+            }
+        };
+
+        std::for_each(_component_to_signatures[id].begin(), _component_to_signatures[id].end(), match);
+        std::for_each(_component_to_exclusions[id].begin(), _component_to_exclusions[id].end(), match);
+        std::for_each(_component_to_optionals[id].begin(), _component_to_optionals[id].end(), match);
+        std::for_each(_empty_signatures.begin(), _empty_signatures.end(), match);
+    }
+
+    // Every entity has the signature
+    void EnterGroups(Span<const Entity> entities, const Signature &signature) {
+        signature.ForEachComponent([&](Component id) {
+            if (_component_to_group[id])
+                _component_to_group[id]->OnComponentsAdded(entities, signature);
+        });
+    }
+
+    void RecordRemoval(Entity entity, const Signature &signature) {
+        signature.ForEachComponent([&](Component id) {
+            if (_observers.IsObserved(id, ComponentEvent::Remove))
+                _observers.Record(id, ComponentEvent::Remove, entity, signature);
+        });
+    }
+
+    // Has to be called while entity still has its components
+    void LeaveGroups(EntityIndex index, const Signature &signature) {
+        signature.ForEachComponent([&](Component id) {
+            if (_component_to_group[id])
+                _component_to_group[id]->OnComponentRemoving(index);
+        });
+    }
+
+    // Invalidates handles to the index and makes it available for reuse
+    void ReleaseEntity(EntityIndex index) {
+        _signatures.RemoveData(index);
+        _structure_version++;
+        _generations[index]++;
+        _free_indices.push_back(index);
+    }
+
+#if !ARCHETYPE_STORAGE
     template<typename T>
-    void VerifyComponentRegistration() {
-        std::string type_name = typeid(T).name();
+    void FillComponents(const std::vector<Entity> &entities, const T &component) {
+        ComponentArray<T> &component_array = GetComponentArray<T>();
+        component_array.Reserve(component_array.GetSize() + entities.size());
+        for (Entity entity : entities) {
+            component_array.SetData(GetEntityIndex(entity), component);
+            component_array.ticks.MarkAdded(GetEntityIndex(entity), GetTick());
+        }
+    }
+#endif
 
-        assert(_name_to_component_index.find(type_name) != _name_to_component_index.end() && "This component hasn't been registered");
+    // const T names the same component as T, as in ForEach<P, const V>
+    template<typename T>
+    void VerifyComponentRegistration() {
+#if ARCHETYPE_STORAGE
+        assert(_archetypes.IsRegistered(component_type_id<std::remove_const_t<T>>) && "This component hasn't been registered");
+#else
+        assert(_components.HasData(component_type_id<std::remove_const_t<T>>) && "This component hasn't been registered");
+#endif
     }
 };
+
+inline FrameArena &System::GetScratch() {
+    return _engine.GetFrameArena();
+}
+
+inline void System::Run(float dt) {
+    _last_run_tick = _run_tick;
+    _run_tick = _engine.GetTick();
+    Update(dt);
+    // Whatever happens after the run is newer than changes made by it
+    _engine.AdvanceTick();
+}
+
+template<typename S>
+void System::RunAs(float dt) {
+    _last_run_tick = _run_tick;
+    _run_tick = _engine.GetTick();
+    static_cast<S *>(this)->S::Update(dt);
+    _engine.AdvanceTick();
+}
+
+template<typename Func>
+void System::ParallelForEach(size_t type, Func func, size_t grain) {
+    ValidateSignatureID(type);
+    std::vector<Entity> &targets = _targets[type].entries;
+
+    ThreadPool *pool = _engine.GetThreadPool();
+    if (!pool) {
+        for (Entity entity : targets)
+            func(entity);
+        return;
+    }
+
+    pool->ParallelFor(targets.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            func(targets[i]);
+    });
+}
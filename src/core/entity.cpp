@@ -1,26 +1,12 @@
 #include "entity.hpp"
-#include "constants.hpp"
-#include <cassert>
-#include <bitset>
 
-void Signature::VerifyID(Component id) {
-    assert(id >= 0 && id < components.size() && "Given component id is out of range");
+std::size_t Signature::Hash() const {
+    // Mix every word in, so signatures differing in high components spread as well
+    std::uint64_t hash = 0x9e3779b97f4a7c15ull;
+    for (Word word : words) {
+        hash ^= word + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+    }
+    return static_cast<std::size_t>(hash);
 }
-
-void Signature::AddComponent(Component id) {
-    VerifyID(id);
-    components.set(id);
-}
-
-void Signature::RemoveComponent(Component id) {
-    VerifyID(id);
-    components.reset(id);
-}
-
-bool Signature::IsSufficientFor(Signature& gate) {
-    return (components & gate.components).count() == gate.components.count();
-}
-
-void Signature::Reset() {
-    components.reset();
-}
\ No newline at end of file
@@ -1,18 +1,162 @@
 #pragma once
 
 #include "constants.hpp"
-#include <bitset>
 
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+constexpr EntityIndex GetEntityIndex(Entity entity) {
+    return static_cast<EntityIndex>(entity);
+}
+
+constexpr EntityGeneration GetEntityGeneration(Entity entity) {
+    return static_cast<EntityGeneration>(entity >> 32);
+}
+
+constexpr Entity MakeEntity(EntityIndex index, EntityGeneration generation) {
+    return (static_cast<Entity>(generation) << 32) | index;
+}
+
+// Set of component ids packed into 64-bit words, MAX_COMPONENTS wide.
+// Subset tests compare whole words, with SSE/AVX when available, so matching cost
+// depends on the amount of words rather than on the amount of components
 struct Signature {
-    void AddComponent(Component id);
+    using Word = std::uint64_t;
+    static constexpr Component WORD_BITS = 64;
+    static constexpr std::size_t WORD_COUNT = (MAX_COMPONENTS + WORD_BITS - 1) / WORD_BITS;
+
+    std::array<Word, WORD_COUNT> words {};
+
+    constexpr Signature() = default;
+
+    constexpr Signature(std::initializer_list<Component> ids) {
+        for (Component id : ids)
+            AddComponent(id);
+    }
+
+    constexpr void AddComponent(Component id) {
+        assert(id < MAX_COMPONENTS && "Given component id is out of range");
+        words[id / WORD_BITS] |= Word(1) << (id % WORD_BITS);
+    }
+
+    constexpr void RemoveComponent(Component id) {
+        assert(id < MAX_COMPONENTS && "Given component id is out of range");
+        words[id / WORD_BITS] &= ~(Word(1) << (id % WORD_BITS));
+    }
+
+    constexpr bool Has(Component id) const {
+        return words[id / WORD_BITS] >> (id % WORD_BITS) & 1;
+    }
+
+    constexpr void Reset() {
+        words = {};
+    }
+
+    constexpr bool IsEmpty() const {
+        for (Word word : words) {
+            if (word)
+                return false;
+        }
+        return true;
+    }
+
+    // True when this has every component of gate
+    bool IsSufficientFor(const Signature &gate) const;
+
+    // True when this and other share a component
+    bool Intersects(const Signature &other) const;
+
+    // Calls func(Component) for every component, in ascending order
+    template<typename Func>
+    void ForEachComponent(Func func) const {
+        for (std::size_t i = 0; i < WORD_COUNT; i++) {
+            Word word = words[i];
+            while (word) {
+                func(static_cast<Component>(i * WORD_BITS + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    std::size_t Hash() const;
+
+    constexpr bool operator==(const Signature &other) const {
+        for (std::size_t i = 0; i < WORD_COUNT; i++) {
+            if (words[i] != other.words[i])
+                return false;
+        }
+        return true;
+    }
 
-    void RemoveComponent(Component id);
+    constexpr bool operator!=(const Signature &other) const {
+        return !(*this == other);
+    }
+};
 
-    void Reset();
+namespace std {
+template<>
+struct hash<Signature> {
+    std::size_t operator()(const Signature &signature) const {
+        return signature.Hash();
+    }
+};
+}
 
-    bool IsSufficientFor(Signature& gate);
+inline bool Signature::IsSufficientFor(const Signature &gate) const {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= WORD_COUNT; i += 4) {
+        __m256i have = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&words[i]));
+        __m256i need = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&gate.words[i]));
+        // Carry flag: (~have & need) == 0
+        if (!_mm256_testc_si256(have, need))
+            return false;
+    }
+#endif
+#if defined(__SSE4_1__)
+    for (; i + 2 <= WORD_COUNT; i += 2) {
+        __m128i have = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&words[i]));
+        __m128i need = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&gate.words[i]));
+        if (!_mm_testc_si128(have, need))
+            return false;
+    }
+#endif
+    for (; i < WORD_COUNT; i++) {
+        if ((words[i] & gate.words[i]) != gate.words[i])
+            return false;
+    }
+    return true;
+}
 
-    std::bitset<MAX_COMPONENTS> components;
-private:
-    void VerifyID(Component id);
-};
\ No newline at end of file
+inline bool Signature::Intersects(const Signature &other) const {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= WORD_COUNT; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&words[i]));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&other.words[i]));
+        // Zero flag: (a & b) == 0
+        if (!_mm256_testz_si256(a, b))
+            return true;
+    }
+#endif
+#if defined(__SSE4_1__)
+    for (; i + 2 <= WORD_COUNT; i += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&words[i]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&other.words[i]));
+        if (!_mm_testz_si128(a, b))
+            return true;
+    }
+#endif
+    Word common = 0;
+    for (; i < WORD_COUNT; i++)
+        common |= words[i] & other.words[i];
+    return common != 0;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "component.hpp"
+#include "entity.hpp"
+#include "span.hpp"
+#include "thread_pool.hpp"
+#include "view.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class IGroup {
+public:
+    // Called after entity's signature gained an owned component
+    virtual void OnComponentAdded(EntityIndex index, const Signature &signature) = 0;
+
+    // Same for entities which all have the signature
+    virtual void OnComponentsAdded(Span<const Entity> entities, const Signature &signature) = 0;
+
+    // Called before an owned component is removed from the entity
+    virtual void OnComponentRemoving(EntityIndex index) = 0;
+
+    virtual ~IGroup() = default;
+};
+
+// Owns component arrays of Ts: entities having all of Ts are kept in the same prefix
+// of every owned array, in the same order, so iteration is a linear walk with no lookups.
+// A component type can be owned by a single group only
+template<typename ...Ts>
+class Group : public IGroup {
+    static_assert(sizeof...(Ts) > 1, "Group needs at least two component types");
+    static_assert((std::is_same_v<decltype(std::declval<ComponentArray<Ts> &>().GetData(0)), Ts &> && ...),
+        "Group can only own components stored in packed arrays");
+    // Tags hand out one shared instance, so the packed array check above lets them through
+    static_assert((!std::is_same_v<typename ComponentStoragePolicy<Ts>::type, TagStorage> && ...),
+        "Group cannot own tag components, they have no entries to reorder. Join them in a View instead");
+
+    std::tuple<ComponentArray<Ts> *...> _arrays;
+    const std::vector<EntityGeneration> *_generations;
+    const std::atomic<Tick> *_tick;
+    Signature _signature;
+    std::uint32_t _size;
+
+public:
+    Group(const std::vector<EntityGeneration> &generations, const std::atomic<Tick> &tick, ComponentArray<Ts> &...arrays)
+        : _arrays(&arrays...), _generations(&generations), _tick(&tick), _size(0) {
+        (_signature.AddComponent(component_type_id<Ts>), ...);
+
+        // Gather entities which already have everything
+        auto &first = std::get<0>(_arrays);
+        for (std::uint32_t i = 0; i < first->GetSize(); i++) {
+            EntityIndex index = first->GetEntry(i);
+            if ((std::get<ComponentArray<Ts> *>(_arrays)->HasData(index) && ...))
+                Enter(index);
+        }
+    }
+
+    std::uint32_t GetSize() const {
+        return _size;
+    }
+
+    bool Contains(EntityIndex index) const {
+        return std::get<0>(_arrays)->GetInternalIndex(index) < _size;
+    }
+
+    void OnComponentAdded(EntityIndex index, const Signature &signature) override {
+        if (signature.IsSufficientFor(_signature) && !Contains(index))
+            Enter(index);
+    }
+
+    void OnComponentsAdded(Span<const Entity> entities, const Signature &signature) override {
+        if (!signature.IsSufficientFor(_signature))
+            return;
+        for (Entity entity : entities) {
+            if (!Contains(GetEntityIndex(entity)))
+                Enter(GetEntityIndex(entity));
+        }
+    }
+
+    void OnComponentRemoving(EntityIndex index) override {
+        if (Contains(index))
+            Leave(index);
+    }
+
+    // Calls func(Entity, Ts&...) or func(Ts&...) for every entity in the group.
+    // Every visited component is stamped as changed
+    template<typename Func>
+    void ForEach(Func func) {
+        IterateRange(func, 0, _size);
+    }
+
+    // Func must be safe to call concurrently, use PerWorker for scratch data
+    template<typename Func>
+    void ParallelForEach(ThreadPool *pool, Func func, std::uint32_t grain = 1024) {
+        if (!pool) {
+            ForEach(func);
+            return;
+        }
+
+        pool->ParallelFor(_size, grain, [&](std::size_t begin, std::size_t end) {
+            IterateRange(func, begin, end);
+        });
+    }
+
+    // Packed data of an owned component, [0, GetSize()) is aligned across all owned arrays
+    template<typename T>
+    T *GetData() {
+        return std::get<ComponentArray<T> *>(_arrays)->entries.data();
+    }
+
+private:
+    template<typename Func>
+    void IterateRange(Func &func, std::uint32_t begin, std::uint32_t end) {
+        auto &first = *std::get<0>(_arrays);
+        std::tuple<Ts *...> data(GetData<Ts>()...);
+        Tick tick = _tick->load(std::memory_order_relaxed);
+
+        for (std::uint32_t i = begin; i < end; i++) {
+            EntityIndex index = first.GetEntry(i);
+            InvokeWithEntity(func, MakeEntity(index, (*_generations)[index]), std::get<Ts *>(data)[i]...);
+            (std::get<ComponentArray<Ts> *>(_arrays)->ticks.MarkChanged(index, tick), ...);
+        }
+    }
+
+    void Enter(EntityIndex index) {
+        (MoveTo(*std::get<ComponentArray<Ts> *>(_arrays), index, _size), ...);
+        _size++;
+    }
+
+    void Leave(EntityIndex index) {
+        _size--;
+        (MoveTo(*std::get<ComponentArray<Ts> *>(_arrays), index, _size), ...);
+    }
+
+    template<typename T>
+    static void MoveTo(ComponentArray<T> &array, EntityIndex index, std::uint32_t position) {
+        array.SwapSlots(array.GetInternalIndex(index), position);
+    }
+};
@@ -0,0 +1,137 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+HugePageResource::HugePageResource(std::size_t threshold, std::pmr::memory_resource *upstream)
+    : _threshold(threshold), _upstream(upstream) {}
+
+bool HugePageResource::IsMapped(std::size_t bytes, std::size_t alignment) const {
+#if defined(__linux__)
+    // Mappings are only guaranteed to be aligned to regular pages
+    return bytes >= _threshold && alignment <= static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+    (void)bytes;
+    (void)alignment;
+    return false;
+#endif
+}
+
+void *HugePageResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    if (!IsMapped(bytes, alignment))
+        return _upstream->allocate(bytes, alignment);
+
+#if defined(__linux__)
+    std::size_t size = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+    void *pointer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pointer == MAP_FAILED) {
+        // No reserved huge pages - fall back to transparent ones
+        pointer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pointer == MAP_FAILED)
+            throw std::bad_alloc();
+#if defined(MADV_HUGEPAGE)
+        madvise(pointer, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    _mapped_bytes.fetch_add(size, std::memory_order_relaxed);
+    return pointer;
+#else
+    return nullptr;
+#endif
+}
+
+void HugePageResource::do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) {
+    if (!IsMapped(bytes, alignment)) {
+        _upstream->deallocate(pointer, bytes, alignment);
+        return;
+    }
+
+#if defined(__linux__)
+    std::size_t size = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    munmap(pointer, size);
+    _mapped_bytes.fetch_sub(size, std::memory_order_relaxed);
+#endif
+}
+
+bool HugePageResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+FrameArena::FrameArena(std::size_t capacity, std::pmr::memory_resource *upstream) : _upstream(upstream) {
+    AddBlock(capacity);
+}
+
+FrameArena::~FrameArena() {
+    ReleaseBlocks();
+}
+
+void FrameArena::Reset() {
+    if (_blocks.size() > 1) {
+        // Merge into a single block big enough for the whole frame
+        std::size_t capacity = GetCapacity();
+        ReleaseBlocks();
+        AddBlock(capacity);
+    }
+    _offset = 0;
+    _used_in_full_blocks = 0;
+}
+
+std::size_t FrameArena::GetCapacity() const {
+    std::size_t capacity = 0;
+    for (const Block &block : _blocks)
+        capacity += block.size;
+    return capacity;
+}
+
+std::size_t FrameArena::GetUsedBytes() const {
+    return _used_in_full_blocks + _offset;
+}
+
+void FrameArena::AddBlock(std::size_t size) {
+    assert(!_locked && "Frame arena had to grow while its capacity is locked");
+    _blocks.push_back({ static_cast<std::byte *>(_upstream->allocate(size, alignof(std::max_align_t))), size });
+    _upstream_allocations++;
+}
+
+void FrameArena::ReleaseBlocks() {
+    for (const Block &block : _blocks)
+        _upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+    _blocks.clear();
+}
+
+void *FrameArena::Bump(std::size_t bytes, std::size_t alignment) {
+    Block &block = _blocks.back();
+    void *pointer = block.data + _offset;
+    std::size_t space = block.size - _offset;
+    if (!std::align(alignment, bytes, pointer, space))
+        return nullptr;
+
+    _offset = static_cast<std::byte *>(pointer) - block.data + bytes;
+    return pointer;
+}
+
+void *FrameArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    void *pointer = Bump(bytes, alignment);
+    if (pointer)
+        return pointer;
+
+    _used_in_full_blocks += _offset;
+    _offset = 0;
+    AddBlock(std::max(bytes + alignment, _blocks.back().size));
+    return Bump(bytes, alignment);
+}
+
+void FrameArena::do_deallocate(void *, std::size_t, std::size_t) {}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
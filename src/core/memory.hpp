@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Component pools allocate through std::pmr::memory_resource, so the engine can be given
+// any resource: new/delete by default, std::pmr::monotonic_buffer_resource as an arena
+// sized up front, or HugePageResource below
+template<typename T>
+using PoolAllocator = std::pmr::polymorphic_allocator<T>;
+
+// Heap allocations made so far through operator new, on any thread. Defined by the
+// ECSAllocationCounter object library, which replaces global operator new: link it to call this.
+// The engine links it and checks locked frames with ECS_COUNT_ALLOCATIONS, see Engine::LockFrameMemory
+std::size_t GetHeapAllocationCount();
+
+// Bytes held by a component pool: reserved is everything it allocated, used is what alive
+// components occupy. index is the part of reserved taken by bookkeeping: sparse index,
+// packed entry list and change ticks
+struct PoolMemory {
+    std::size_t reserved = 0;
+    std::size_t used = 0;
+    std::size_t index = 0;
+
+    PoolMemory &operator+=(const PoolMemory &other) {
+        reserved += other.reserved;
+        used += other.used;
+        index += other.index;
+        return *this;
+    }
+};
+
+// Large blocks are mapped directly and backed by huge pages to cut TLB misses on big pools.
+// Tries MAP_HUGETLB first, then a regular mapping with madvise(MADV_HUGEPAGE), which the kernel
+// may or may not honor. Small blocks and platforms without mmap go to upstream
+class HugePageResource : public std::pmr::memory_resource {
+public:
+    static constexpr std::size_t HUGE_PAGE_SIZE = std::size_t(2) << 20;
+
+    // Blocks of at least threshold bytes are mapped
+    explicit HugePageResource(std::size_t threshold = HUGE_PAGE_SIZE / 2,
+        std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+
+    HugePageResource(const HugePageResource &) = delete;
+    HugePageResource &operator=(const HugePageResource &) = delete;
+
+    // Bytes currently mapped, including rounding up to whole huge pages
+    std::size_t GetMappedBytes() const {
+        return _mapped_bytes.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::size_t _threshold;
+    std::pmr::memory_resource *_upstream;
+    std::atomic<std::size_t> _mapped_bytes { 0 };
+
+    bool IsMapped(std::size_t bytes, std::size_t alignment) const;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+// Linear allocator for data which lives until the end of a frame: allocation bumps an offset,
+// deallocation does nothing and Reset frees everything at once.
+// When a frame outgrows the arena, extra blocks are taken from upstream and merged into one
+// on the next Reset, so once frames stop growing the arena stops allocating
+class FrameArena : public std::pmr::memory_resource {
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = std::size_t(64) << 10;
+
+    explicit FrameArena(std::size_t capacity = DEFAULT_CAPACITY,
+        std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    ~FrameArena();
+
+    // Everything allocated so far must be dead
+    void Reset();
+
+    std::size_t GetCapacity() const;
+
+    std::size_t GetUsedBytes() const;
+
+    // Times the arena went to upstream, the debug counter for steady state frames
+    std::size_t GetUpstreamAllocationCount() const {
+        return _upstream_allocations;
+    }
+
+    // While locked, growing the arena asserts in debug builds
+    void LockCapacity(bool locked = true) {
+        _locked = locked;
+    }
+
+private:
+    struct Block {
+        std::byte *data;
+        std::size_t size;
+    };
+
+    std::pmr::memory_resource *_upstream;
+    // Blocks beyond the first one are only there until the next Reset
+    std::vector<Block> _blocks;
+    std::size_t _offset = 0;
+    std::size_t _used_in_full_blocks = 0;
+    std::size_t _upstream_allocations = 0;
+    bool _locked = false;
+
+    void AddBlock(std::size_t size);
+    void ReleaseBlocks();
+    // nullptr when the last block has no room
+    void *Bump(std::size_t bytes, std::size_t alignment);
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
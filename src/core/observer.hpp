@@ -0,0 +1,116 @@
+#pragma once
+
+#include "constants.hpp"
+#include "entity.hpp"
+#include "span.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+enum class ComponentEvent : std::uint8_t {
+    // Entity got a component it did not have
+    Add,
+    // Component was removed or its entity was deleted. Entity might not be alive on delivery
+    Remove,
+    // Existing component was replaced through SetComponent or EmplaceComponent
+    Set,
+};
+
+enum class ObserverPhase : std::uint8_t {
+    // After every sync point of Update, once deferred commands are applied
+    SyncPoint,
+    // Once at the end of Update
+    FrameEnd,
+};
+
+// Collects component events into a batch per observer, callbacks get whole batches as spans
+class ObserverRegistry {
+public:
+    using Callback = std::function<void(Span<const Entity>)>;
+
+    // Only entities whose signature contains filter are reported
+    void Add(Component id, ComponentEvent event, ObserverPhase phase, const Signature &filter, Callback callback) {
+        auto observer = std::make_unique<Observer>();
+        observer->phase = phase;
+        observer->filter = filter;
+        observer->callback = std::move(callback);
+        observer->batches.resize(_worker_count);
+
+        _by_component[static_cast<std::size_t>(event)][id].push_back(observer.get());
+        _observers.push_back(std::move(observer));
+    }
+
+    bool IsObserved(Component id, ComponentEvent event) const {
+        return !_by_component[static_cast<std::size_t>(event)][id].empty();
+    }
+
+    // Every worker records into batches of its own, so systems updating in parallel
+    // may raise events, e.g. Set, without locking. See ThreadPool::GetWorkerIndex
+    void SetWorkerCount(std::size_t count) {
+        _worker_count = std::max(_worker_count, count);
+        for (auto &observer : _observers)
+            observer->batches.resize(_worker_count);
+    }
+
+    // Signature is the one entity has with the component, removal is recorded before it happens
+    void Record(Component id, ComponentEvent event, Entity entity, const Signature &signature, std::size_t worker = 0) {
+        assert(worker < _worker_count && "Worker has no batches");
+        for (Observer *observer : _by_component[static_cast<std::size_t>(event)][id]) {
+            if (signature.IsSufficientFor(observer->filter))
+                observer->batches[worker].push_back(entity);
+        }
+    }
+
+    // Same as Record for entities sharing the signature
+    void Record(Component id, ComponentEvent event, Span<const Entity> entities, const Signature &signature,
+                std::size_t worker = 0) {
+        assert(worker < _worker_count && "Worker has no batches");
+        for (Observer *observer : _by_component[static_cast<std::size_t>(event)][id]) {
+            if (signature.IsSufficientFor(observer->filter)) {
+                std::vector<Entity> &batch = observer->batches[worker];
+                batch.insert(batch.end(), entities.begin(), entities.end());
+            }
+        }
+    }
+
+    // Batches of all workers are merged in worker order.
+    // Events raised by callbacks are collected into the next batch
+    void Deliver(ObserverPhase phase) {
+        for (std::size_t i = 0; i < _observers.size(); i++) {
+            Observer &observer = *_observers[i];
+            if (observer.phase != phase)
+                continue;
+
+            for (std::vector<Entity> &batch : observer.batches) {
+                observer.delivering.insert(observer.delivering.end(), batch.begin(), batch.end());
+                batch.clear();
+            }
+            if (observer.delivering.empty())
+                continue;
+            observer.callback(observer.delivering);
+            observer.delivering.clear();
+        }
+    }
+
+private:
+    struct Observer {
+        ObserverPhase phase;
+        Signature filter;
+        Callback callback;
+        // Per worker, see SetWorkerCount
+        std::vector<std::vector<Entity>> batches;
+        std::vector<Entity> delivering;
+    };
+
+    static constexpr std::size_t EVENT_COUNT = 3;
+
+    std::vector<std::unique_ptr<Observer>> _observers;
+    std::size_t _worker_count = 1;
+    std::array<std::array<std::vector<Observer *>, MAX_COMPONENTS>, EVENT_COUNT> _by_component;
+};
@@ -1,87 +1,312 @@
 #pragma once
-#include <array>
+#include "memory.hpp"
+#include "sparse_index.hpp"
+
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-template<typename T, uint32_t MAX_SIZE>
-class PackedArray {
+// Sparse set of entries: alive entries are kept packed, lookups go through SparseIndex.
+// Paged index by default so memory grows with the entries actually used rather than with a fixed maximum.
+// Derived storages keep their data at the same internal indices as entries
+template<typename SparseIndex = PagedSparseIndex>
+class SparseSet {
+protected:
     using Index = std::uint32_t;
+    static constexpr Index INVALID_INDEX = SparseIndex::INVALID;
+
     Index _entry_count;
-    std::array<Index, MAX_SIZE> _entry_to_index;
-    std::array<Index, MAX_SIZE> _index_to_entry;
+    SparseIndex _entry_to_index;
+    // [0, _entry_count) are alive entries, the rest are removed ones waiting to be reused.
+    // Indices with ERASES_RELEASED keep only the alive ones
+    std::pmr::vector<Index> _index_to_entry;
 
 public:
-    std::array<T, MAX_SIZE> entries;
+    explicit SparseSet(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : _entry_count(0), _entry_to_index(resource), _index_to_entry(resource) {}
 
-    PackedArray() : _entry_count(0) {
-        for (unsigned int i = 0; i < MAX_SIZE; i++) {
-            _entry_to_index[i] = i;
-            _index_to_entry[i] = i;
-        }
+    SparseSet(SparseSet &&) = default;
+    SparseSet &operator=(SparseSet &&) = default;
+
+    bool HasData(Index entry) const {
+        return GetIndex(entry) < _entry_count;
     }
 
-    bool HasData(Index entry) {
-        return _entry_to_index[entry] < _entry_count;
+    // BEWARE RETURED INDEX IS INTERNAL
+    // AND THEREFORE SHOULD ONLY BE USED TO ITERATE OVER INTERNAL ARRAY
+    Index GetSize() const {
+        return _entry_count;
     }
 
-    void RemoveData(Index entry) {
+	Index size() const {
+		return _entry_count;
+	}
+
+    // Entry stored at internal index
+    Index GetEntry(Index index) const {
+        assert(index < _entry_count && "Index is out of bounds");
+        return _index_to_entry[index];
+    }
+
+    // Internal index of the entry, not less than GetSize() when it has no data
+    Index GetInternalIndex(Index entry) const {
+        return GetIndex(entry);
+    }
+
+    // Iteration interface shared with other component storages:
+    // entries stored at internal indices [begin, end) are visited
+    Index GetSlotCount() const {
+        return _entry_count;
+    }
+
+    // Bytes held by the sparse index and the packed entry list
+    std::size_t GetIndexMemory() const {
+        return _entry_to_index.GetMemory() + _index_to_entry.capacity() * sizeof(Index);
+    }
+
+    // Only meaningful when entries are allocated exclusively through AddData
+    Index GetEmptyEntry() const {
+        static_assert(!SparseIndex::ERASES_RELEASED, "Released entries are forgotten, so none is known to be empty");
+        if (_entry_count < _index_to_entry.size())
+            return _index_to_entry[_entry_count];
+        return _index_to_entry.size();
+    }
+
+protected:
+    // Moves entry right past the alive ones, its data has to be appended next
+    void ClaimEntry(Index entry, Index index) {
+        if (index == INVALID_INDEX) {
+            // Never seen before - make room for it at the end of helper array
+            index = _index_to_entry.size();
+            _index_to_entry.push_back(entry);
+            SetIndex(entry, index);
+        }
+
+        // Swap it with the entry occupying first free place
+        // so helper arrays stay a permutation
+        Index displaced_entry = _index_to_entry[_entry_count];
+
+        SetIndex(displaced_entry, index);
+        _index_to_entry[index] = displaced_entry;
+
+        SetIndex(entry, _entry_count);
+        _index_to_entry[_entry_count] = entry;
+    }
+
+    // Swaps entry with the last alive one and shrinks alive range.
+    // Returns index entry was at, data of the last one has to be moved there
+    Index ReleaseEntry(Index entry) {
         assert(HasData(entry) && "Entry does not have valid data to remove");
 
+        Index removed_index = GetIndex(entry);
+        _entry_count--;
+
         // If not the last one
-        if (_entry_to_index[entry] < _entry_count - 1) {
-            // Move last one to deleted position
-            // Adjust helper arrays
-            Index removed_index = _entry_to_index[entry];
-            Index last_entry = _index_to_entry[_entry_count - 1];
+        if (removed_index < _entry_count) {
+            Index last_entry = _index_to_entry[_entry_count];
 
-            _entry_to_index[last_entry] = removed_index;
+            SetIndex(last_entry, removed_index);
             _index_to_entry[removed_index] = last_entry;
-			
-			_entry_to_index[entry] = _entry_count - 1;
-			_index_to_entry[_entry_count - 1] = entry;
 
-            // Actually move data
-            entries[removed_index] = entries[_entry_count - 1];
+            SetIndex(entry, _entry_count);
+            _index_to_entry[_entry_count] = entry;
+        }
+        if constexpr (SparseIndex::ERASES_RELEASED)
+            ForgetReleased(entry);
+        return removed_index;
+    }
+
+    // Derived storage has to swap its data at the same indices
+    void SwapEntries(Index a, Index b) {
+        Index entry_a = _index_to_entry[a];
+        Index entry_b = _index_to_entry[b];
+
+        _index_to_entry[a] = entry_b;
+        SetIndex(entry_b, a);
+        _index_to_entry[b] = entry_a;
+        SetIndex(entry_a, b);
+    }
+
+    // Shifts entries after the removed one back. Returns index entry was at
+    Index ReleaseEntryOrdered(Index entry) {
+        assert(HasData(entry) && "Entry does not have valid data to remove");
+
+        Index removed_index = GetIndex(entry);
+        for (Index i = removed_index; i + 1 < _entry_count; i++) {
+            Index moved_entry = _index_to_entry[i + 1];
+            _index_to_entry[i] = moved_entry;
+            SetIndex(moved_entry, i);
         }
 
         _entry_count--;
+        _index_to_entry[_entry_count] = entry;
+        SetIndex(entry, _entry_count);
+        if constexpr (SparseIndex::ERASES_RELEASED)
+            ForgetReleased(entry);
+        return removed_index;
+    }
+
+    // Drops entry just released from the index and the end of the entry list.
+    // The list gives memory back once it is mostly unused
+    void ForgetReleased(Index entry) {
+        assert(_index_to_entry.size() == _entry_count + 1 && "Only the released entry may be past the alive ones");
+        _entry_to_index.Erase(entry);
+        _index_to_entry.pop_back();
+        if (_index_to_entry.size() * 4 < _index_to_entry.capacity())
+            _index_to_entry.shrink_to_fit();
+    }
+
+    void ReserveEntries(Index capacity) {
+        _index_to_entry.reserve(capacity);
+        _entry_to_index.Reserve(capacity);
+    }
+
+    Index GetIndex(Index entry) const {
+        return _entry_to_index.Get(entry);
+    }
+
+    void SetIndex(Index entry, Index index) {
+        _entry_to_index.Set(entry, index);
+    }
+};
+
+// Sparse set with data kept packed in `entries`, allocated through Allocator
+template<typename T, typename SparseIndex = PagedSparseIndex, typename Allocator = std::allocator<T>>
+class PackedArray : public SparseSet<SparseIndex> {
+    using Base = SparseSet<SparseIndex>;
+    using typename Base::Index;
+    using Base::_entry_count;
+    using Base::GetIndex;
+
+public:
+    std::vector<T, Allocator> entries;
+
+    PackedArray() = default;
+
+    // Polymorphic allocator's resource serves the sparse set as well
+    explicit PackedArray(const Allocator &allocator) : Base(ResourceOf(allocator)), entries(allocator) {}
+
+    PackedArray(PackedArray &&) = default;
+    PackedArray &operator=(PackedArray &&) = default;
+
+    void RemoveData(Index entry) {
+        // Move last one to deleted position
+        Index removed_index = this->ReleaseEntry(entry);
+        if (removed_index < _entry_count)
+            entries[removed_index] = std::move(entries[_entry_count]);
+
+        entries.pop_back();
+    }
+
+    // Same as RemoveData but keeps the order of remaining entries. O(n)
+    void RemoveDataOrdered(Index entry) {
+        Index removed_index = this->ReleaseEntryOrdered(entry);
+        entries.erase(entries.begin() + removed_index);
+    }
+
+    // Exchanges places of entries stored at internal indices a and b
+    void SwapSlots(Index a, Index b) {
+        assert(a < _entry_count && b < _entry_count && "Index is out of bounds");
+        if (a == b)
+            return;
+        this->SwapEntries(a, b);
+        std::swap(entries[a], entries[b]);
     }
 
     T &GetData(Index entry) {
-        assert(HasData(entry) && "Entry does not have valid data");
-        
-        return entries[_entry_to_index[entry]];
+        assert(this->HasData(entry) && "Entry does not have valid data");
+
+        return entries[GetIndex(entry)];
+    }
+
+    // Single lookup alternative to HasData + GetData
+    T *TryGetData(Index entry) {
+        Index index = GetIndex(entry);
+        return index < _entry_count ? &entries[index] : nullptr;
     }
 
     void SetData(Index entry, const T &data) {
-        // If entry is new
-        if (_entry_to_index[entry] >= _entry_count) {
-            
-            _entry_to_index[entry] = _entry_count;
-            _index_to_entry[_entry_count] = entry;
+        EmplaceData(entry, data);
+    }
+
+    void SetData(Index entry, T &&data) {
+        EmplaceData(entry, std::move(data));
+    }
 
-            _entry_count++;
+    // Constructs data in place, or replaces existing data. Aggregates are brace-initialized
+    template<typename ...Args>
+    T &EmplaceData(Index entry, Args &&...args) {
+        Index index = GetIndex(entry);
+
+        if (index < _entry_count) {
+            if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::decay_t<Args>, T> && ...))
+                entries[index] = (std::forward<Args>(args), ...);
+            else
+                entries[index] = Make(std::forward<Args>(args)...);
+            return entries[index];
         }
 
-        entries[_entry_to_index[entry]] = data;
+        this->ClaimEntry(entry, index);
+        if constexpr (std::is_constructible_v<T, Args &&...>)
+            entries.emplace_back(std::forward<Args>(args)...);
+        else
+            entries.emplace_back(Make(std::forward<Args>(args)...));
+        return entries[_entry_count++];
     }
 
-    // BEWARE RETURED INDEX IS INTERNAL
-    // AND THEREFORE SHOULD ONLY BE USED TO ITERATE OVER INTERNAL ARRAY
-    Index GetSize() const {
-        return _entry_count;
+    typename std::vector<T, Allocator>::iterator begin() {
+        return entries.begin();
     }
-	
-	Index size() const {
-		return _entry_count;
-	}
 
-    Index GetEmptyEntry() const {
-        return _index_to_entry[_entry_count];
+    typename std::vector<T, Allocator>::iterator end() {
+        return entries.end();
+    }
+
+    // Calls func(entry, data) for entries stored at internal indices [begin, end)
+    template<typename Func>
+    void ForEachInSlots(Index begin, Index end, Func func) {
+        end = std::min(end, _entry_count);
+        for (Index i = begin; i < end; i++)
+            func(this->_index_to_entry[i], entries[i]);
     }
 
     Index AddData(const T &data) {
-        Index place = GetEmptyEntry();
+        Index place = this->GetEmptyEntry();
         SetData(place, data);
         return place;
     }
+
+    // Grows geometrically so repeated reserves for small batches stay amortized O(1)
+    void Reserve(Index capacity) {
+        if (capacity <= entries.capacity())
+            return;
+        capacity = std::max<std::size_t>(capacity, entries.capacity() * 2);
+        entries.reserve(capacity);
+        this->ReserveEntries(capacity);
+    }
+
+    PoolMemory GetMemory() const {
+        std::size_t index = this->GetIndexMemory();
+        return { entries.capacity() * sizeof(T) + index, entries.size() * sizeof(T), index };
+    }
+
+private:
+    static std::pmr::memory_resource *ResourceOf(const Allocator &allocator) {
+        if constexpr (std::is_same_v<Allocator, std::pmr::polymorphic_allocator<T>>)
+            return allocator.resource();
+        else
+            return std::pmr::get_default_resource();
+    }
+
+    template<typename ...Args>
+    static T Make(Args &&...args) {
+        if constexpr (std::is_constructible_v<T, Args &&...>)
+            return T(std::forward<Args>(args)...);
+        else
+            return T{ std::forward<Args>(args)... };
+    }
 };
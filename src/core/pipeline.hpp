@@ -0,0 +1,72 @@
+#pragma once
+
+#include "engine.hpp"
+#include "system.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+// Fixed sequence of systems stored by value and updated without virtual calls,
+// so small systems can be inlined into the loop running them.
+// Systems get their targets like registered ones, but the engine neither owns nor schedules them:
+// run them with Engine::Update(dt, pipeline) on every simulation step, subject to their RunEvery.
+// Each system is constructed from the engine alone
+template<typename ...Systems>
+class Pipeline {
+    static_assert((std::is_base_of_v<System, Systems> && ...), "Pipeline can only hold systems");
+
+    Engine &_engine;
+    std::tuple<Systems...> _systems;
+
+    template<typename>
+    static Engine &ConstructFrom(Engine &engine) {
+        return engine;
+    }
+
+public:
+    explicit Pipeline(Engine &engine) : _engine(engine), _systems(ConstructFrom<Systems>(engine)...) {
+        std::apply([&](Systems &...systems) {
+            assert(!(systems.per_frame || ...) && "Pipeline systems run on simulation steps");
+            (Stagger(systems, systems...), ...);
+            (_engine.AttachSystem(systems), ...);
+        }, _systems);
+    }
+
+    // Engine keeps addresses of the systems
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    ~Pipeline() {
+        std::apply([&](Systems &...systems) { (_engine.DetachSystem(systems), ...); }, _systems);
+    }
+
+    template<typename S>
+    S &Get() {
+        return std::get<S>(_systems);
+    }
+
+    // sync_point is called after every system, like in a sequential engine update.
+    // As with the scheduler, systems running every period-th step get dt of all of them
+    template<typename SyncPoint>
+    void Run(float dt, SyncPoint sync_point) {
+        std::uint64_t step = _engine.GetStep();
+        std::apply([&](Systems &...systems) {
+            ((systems.IsDue(step) ? (systems.template RunAs<Systems>(dt * systems.run_period), sync_point()) : void()), ...);
+        }, _systems);
+    }
+
+private:
+    // Same spreading as for registered systems: by position among staggered ones of the same period
+    template<typename ...Others>
+    static void Stagger(System &system, Others &...others) {
+        if (!system.stagger)
+            return;
+        unsigned int count = 0;
+        bool before = true;
+        ((before = before && static_cast<System *>(&others) != &system,
+            count += before && others.stagger && others.run_period == system.run_period), ...);
+        system.run_phase = count % system.run_period;
+    }
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "component.hpp"
+#include "entity.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+// Ad-hoc entity filter, see Engine::QueryEntities. Also a system signature with exclusions.
+// Matches entities having every component of include, none of exclude
+// and at least one of any_of unless it is empty.
+// Optional components do not affect matching: systems keep targets which have them
+// apart from the rest, see System::GetTargetsWithOptional
+struct Query {
+    Signature include;
+    Signature exclude;
+    Signature any_of;
+    Signature optional;
+
+    template<typename ...Ts>
+    Query &With() {
+        (include.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+        return *this;
+    }
+
+    template<typename ...Ts>
+    Query &Without() {
+        (exclude.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+        return *this;
+    }
+
+    template<typename ...Ts>
+    Query &AnyOf() {
+        (any_of.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+        return *this;
+    }
+
+    template<typename ...Ts>
+    Query &Optional() {
+        (optional.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+        return *this;
+    }
+
+    bool Matches(const Signature &signature) const {
+        return signature.IsSufficientFor(include) && !signature.Intersects(exclude) &&
+            (any_of.IsEmpty() || signature.Intersects(any_of));
+    }
+
+    bool operator==(const Query &other) const {
+        return include == other.include && exclude == other.exclude && any_of == other.any_of &&
+            optional == other.optional;
+    }
+};
+
+// Query prepared for scanning many signatures in a row. Matches of a block of up to 64 signatures
+// are computed without branches into a bit mask. With SSE/AVX every signature is tested whole,
+// a few contiguous vector words each. Otherwise, or when terms mention only a few words,
+// just those words are read
+class QueryScan {
+    using Word = Signature::Word;
+
+#if defined(__AVX2__)
+    static constexpr std::size_t VECTOR_WORDS = 4;
+#elif defined(__SSE4_1__)
+    static constexpr std::size_t VECTOR_WORDS = 2;
+#else
+    static constexpr std::size_t VECTOR_WORDS = 1;
+#endif
+
+    const Query &_query;
+    std::array<std::uint16_t, Signature::WORD_COUNT> _words;
+    std::size_t _word_count = 0;
+    bool _needs_any;
+    bool _whole_signatures;
+
+public:
+    static constexpr std::size_t BLOCK_SIZE = 64;
+
+    explicit QueryScan(const Query &query) : _query(query), _needs_any(!query.any_of.IsEmpty()) {
+        for (std::size_t w = 0; w < Signature::WORD_COUNT; w++) {
+            if (query.include.words[w] | query.exclude.words[w] | query.any_of.words[w])
+                _words[_word_count++] = w;
+        }
+        // Whole signature takes fewer vector operations than the mentioned words take scalar ones
+        _whole_signatures = VECTOR_WORDS > 1 && _word_count * VECTOR_WORDS > Signature::WORD_COUNT;
+    }
+
+    // Bit i is set when signatures[i] matches
+    std::uint64_t MatchBlock(const Signature *signatures, std::size_t count) const {
+        assert(count <= BLOCK_SIZE && "Block is too large");
+        if (_whole_signatures)
+            return MatchWholeBlock(signatures, count);
+
+        std::uint64_t mask = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            Word failed = 0;
+            Word any = 0;
+            for (std::size_t k = 0; k < _word_count; k++) {
+                std::size_t w = _words[k];
+                Word word = signatures[i].words[w];
+                failed |= (~word & _query.include.words[w]) | (word & _query.exclude.words[w]);
+                any |= word & _query.any_of.words[w];
+            }
+            std::uint64_t matched = (failed == 0) & (!_needs_any | (any != 0));
+            mask |= matched << i;
+        }
+        return mask;
+    }
+
+private:
+    // Same as above, every word of every signature is tested, VECTOR_WORDS at a time
+    std::uint64_t MatchWholeBlock(const Signature *signatures, std::size_t count) const {
+        const Word *include = _query.include.words.data();
+        const Word *exclude = _query.exclude.words.data();
+        const Word *any_of = _query.any_of.words.data();
+        std::uint64_t mask = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            const Word *words = signatures[i].words.data();
+            std::size_t w = 0;
+            bool failed = false;
+            bool any = false;
+#if defined(__AVX2__)
+            for (; w + 4 <= Signature::WORD_COUNT; w += 4) {
+                __m256i have = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + w));
+                __m256i need = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(include + w));
+                __m256i reject = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(exclude + w));
+                __m256i some = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(any_of + w));
+                // Carry flag: (~have & need) == 0, zero flag: (have & other) == 0
+                failed |= !_mm256_testc_si256(have, need) | !_mm256_testz_si256(have, reject);
+                any |= !_mm256_testz_si256(have, some);
+            }
+#endif
+#if defined(__SSE4_1__)
+            for (; w + 2 <= Signature::WORD_COUNT; w += 2) {
+                __m128i have = _mm_loadu_si128(reinterpret_cast<const __m128i *>(words + w));
+                __m128i need = _mm_loadu_si128(reinterpret_cast<const __m128i *>(include + w));
+                __m128i reject = _mm_loadu_si128(reinterpret_cast<const __m128i *>(exclude + w));
+                __m128i some = _mm_loadu_si128(reinterpret_cast<const __m128i *>(any_of + w));
+                failed |= !_mm_testc_si128(have, need) | !_mm_testz_si128(have, reject);
+                any |= !_mm_testz_si128(have, some);
+            }
+#endif
+            Word failed_word = 0;
+            Word any_word = 0;
+            for (; w < Signature::WORD_COUNT; w++) {
+                failed_word |= (~words[w] & include[w]) | (words[w] & exclude[w]);
+                any_word |= words[w] & any_of[w];
+            }
+            failed |= failed_word != 0;
+            any |= any_word != 0;
+
+            std::uint64_t matched = !failed && (!_needs_any || any);
+            mask |= matched << i;
+        }
+        return mask;
+    }
+};
+
+namespace std {
+template<>
+struct hash<Query> {
+    std::size_t operator()(const Query &query) const {
+        std::size_t hash = query.include.Hash();
+        hash = hash * 31 + query.exclude.Hash();
+        hash = hash * 31 + query.any_of.Hash();
+        return hash * 31 + query.optional.Hash();
+    }
+};
+}
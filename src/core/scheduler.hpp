@@ -0,0 +1,134 @@
+#pragma once
+
+#include "system.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <typeinfo>
+#include <vector>
+
+// Orders systems into a dependency graph built from their declared reads and writes.
+// Conflicting systems keep registration order, the rest may run concurrently
+class Scheduler {
+    std::vector<System *> _systems;
+    std::vector<std::vector<unsigned int>> _successors;
+    std::vector<std::vector<unsigned int>> _predecessors;
+    std::vector<unsigned int> _levels;
+    std::vector<float> _durations;
+    std::unique_ptr<std::atomic<unsigned int>[]> _remaining;
+    // State of the current Run, kept here so jobs only capture the scheduler and a system id,
+    // which fits std::function without a heap allocation
+    std::uint64_t _step = 0;
+    float _dt = 0;
+    ThreadPool *_pool = nullptr;
+
+public:
+    static bool AreConflicting(const System &first, const System &second) {
+        if (!first.declares_access || !second.declares_access)
+            return true;
+
+        return first.writes.Intersects(second.writes) ||
+               first.writes.Intersects(second.reads) ||
+               first.reads.Intersects(second.writes);
+    }
+
+    void AddSystem(System *system) {
+        unsigned int id = _systems.size();
+        _systems.push_back(system);
+        _successors.emplace_back();
+        _predecessors.emplace_back();
+        _durations.push_back(0.0f);
+
+        unsigned int level = 0;
+        for (unsigned int i = 0; i < id; i++) {
+            if (AreConflicting(*_systems[i], *system)) {
+                _successors[i].push_back(id);
+                _predecessors[id].push_back(i);
+                level = std::max(level, _levels[i] + 1);
+            }
+        }
+        _levels.push_back(level);
+
+        _remaining = std::make_unique<std::atomic<unsigned int>[]>(_systems.size());
+    }
+
+    // Runs every system due on the step once. Without a pool systems run one after another in registration order.
+    // sync_point is called after every system when sequential and once after all of them when parallel
+    void Run(float dt, std::uint64_t step, ThreadPool *pool, const std::function<void()> &sync_point) {
+        _step = step;
+        if (!pool) {
+            for (unsigned int i = 0; i < _systems.size(); i++) {
+                if (!_systems[i]->IsDue(step))
+                    continue;
+                RunSystem(i, dt);
+                sync_point();
+            }
+            return;
+        }
+
+        _dt = dt;
+        _pool = pool;
+        for (unsigned int i = 0; i < _systems.size(); i++)
+            _remaining[i].store(_predecessors[i].size(), std::memory_order_relaxed);
+
+        for (unsigned int i = 0; i < _systems.size(); i++) {
+            if (_predecessors[i].empty())
+                pool->Submit([this, i]() { RunNode(i); });
+        }
+        pool->Wait();
+        sync_point();
+    }
+
+    // Spreads systems of the same period over its phases, in registration order
+    unsigned int GetStaggeredPhase(const System &system) const {
+        unsigned int count = 0;
+        for (System *other : _systems) {
+            if (other != &system && other->stagger && other->run_period == system.run_period)
+                count++;
+        }
+        return count % system.run_period;
+    }
+
+    float GetLastDuration(unsigned int id) const {
+        return _durations[id];
+    }
+
+    // Logs every system with its stage, dependencies and time taken by the last update
+    void Dump() const {
+        Logger::LogAdvanced("Schedule of %u systems\n", (unsigned int)_systems.size());
+        for (unsigned int i = 0; i < _systems.size(); i++) {
+            Logger::LogAdvanced("  #%u stage %u %s took %fms, after:", i, _levels[i], typeid(*_systems[i]).name(), _durations[i] * 1000);
+            for (unsigned int predecessor : _predecessors[i])
+                Logger::LogAdvanced(" #%u", predecessor);
+            Logger::LogAdvanced("\n");
+        }
+    }
+
+private:
+    // Keyed by id, so what the system records is ordered the same whichever thread runs it.
+    // Systems running every period-th step cover the time of all of them
+    void RunSystem(unsigned int id, float dt) {
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t key = ThreadPool::GetTaskKey();
+        ThreadPool::SetTaskKey(id + 1);
+        _systems[id]->Run(dt * _systems[id]->run_period);
+        ThreadPool::SetTaskKey(key);
+        _durations[id] = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Systems which are not due still release their successors
+    void RunNode(unsigned int id) {
+        if (_systems[id]->IsDue(_step))
+            RunSystem(id, _dt);
+
+        for (unsigned int successor : _successors[id]) {
+            if (_remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                _pool->Submit([this, successor]() { RunNode(successor); });
+        }
+    }
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Non-owning view of contiguous elements, stand-in for std::span
+template<typename T>
+class Span {
+    T *_data;
+    std::size_t _size;
+
+public:
+    Span() : _data(nullptr), _size(0) {}
+
+    Span(T *data, std::size_t size) : _data(data), _size(size) {}
+
+    template<typename U, typename = std::enable_if_t<std::is_same_v<std::remove_const_t<T>, U>>>
+    Span(std::vector<U> &vector) : _data(vector.data()), _size(vector.size()) {}
+
+    template<typename U, typename = std::enable_if_t<std::is_const_v<T> && std::is_same_v<std::remove_const_t<T>, U>>>
+    Span(const std::vector<U> &vector) : _data(vector.data()), _size(vector.size()) {}
+
+    T *data() const {
+        return _data;
+    }
+
+    std::size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    T *begin() const {
+        return _data;
+    }
+
+    T *end() const {
+        return _data + _size;
+    }
+
+    T &operator[](std::size_t i) const {
+        assert(i < _size && "Span index is out of bounds");
+        return _data[i];
+    }
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Entry -> packed index lookups used by PackedArray.
+// Get returns INVALID for entries which have never been set.
+// Memory comes from the resource given on construction, GetMemory reports the bytes held.
+// Indices with ERASES_RELEASED forget removed entries, others keep them parked for reuse
+
+// One flat array: fastest lookup, memory grows with the largest entry
+class FlatSparseIndex {
+public:
+    using Index = std::uint32_t;
+    static constexpr Index INVALID = ~0u;
+    static constexpr bool ERASES_RELEASED = false;
+
+    explicit FlatSparseIndex(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : _indices(resource) {}
+
+    Index Get(Index entry) const {
+        return entry < _indices.size() ? _indices[entry] : INVALID;
+    }
+
+    void Set(Index entry, Index index) {
+        if (entry >= _indices.size())
+            _indices.resize(std::max<std::size_t>(entry + 1, _indices.size() * 2), INVALID);
+        _indices[entry] = index;
+    }
+
+    void Reserve(Index capacity) {
+        _indices.reserve(capacity);
+    }
+
+    std::size_t GetMemory() const {
+        return _indices.capacity() * sizeof(Index);
+    }
+
+private:
+    std::pmr::vector<Index> _indices;
+};
+
+// Pages are allocated on first use, so memory grows with the ranges of entries actually used
+class PagedSparseIndex {
+public:
+    using Index = std::uint32_t;
+    static constexpr Index INVALID = ~0u;
+    static constexpr bool ERASES_RELEASED = false;
+
+    explicit PagedSparseIndex(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : _pages(resource) {}
+
+    PagedSparseIndex(PagedSparseIndex &&other) noexcept
+        : _pages(std::move(other._pages)), _page_count(std::exchange(other._page_count, 0)) {}
+
+    // Pages are handed over as they are, so both sides have to use the same resource
+    PagedSparseIndex &operator=(PagedSparseIndex &&other) noexcept {
+        assert(_pages.get_allocator() == other._pages.get_allocator() && "Sparse indices use different memory resources");
+        ReleasePages();
+        _pages = std::move(other._pages);
+        other._pages.clear();
+        _page_count = std::exchange(other._page_count, 0);
+        return *this;
+    }
+
+    ~PagedSparseIndex() {
+        ReleasePages();
+    }
+
+    Index Get(Index entry) const {
+        Index page = entry >> PAGE_BITS;
+        if (page >= _pages.size() || !_pages[page])
+            return INVALID;
+        return _pages[page][entry & (PAGE_SIZE - 1)];
+    }
+
+    void Set(Index entry, Index index) {
+        Index page = entry >> PAGE_BITS;
+        if (page >= _pages.size())
+            _pages.resize(page + 1, nullptr);
+        if (!_pages[page]) {
+            _pages[page] = static_cast<Index *>(_pages.get_allocator().resource()->allocate(PAGE_SIZE * sizeof(Index), alignof(Index)));
+            std::fill_n(_pages[page], PAGE_SIZE, INVALID);
+            _page_count++;
+        }
+        _pages[page][entry & (PAGE_SIZE - 1)] = index;
+    }
+
+    void Reserve(Index capacity) {
+        _pages.reserve((capacity + PAGE_SIZE - 1) >> PAGE_BITS);
+    }
+
+    std::size_t GetMemory() const {
+        return _pages.capacity() * sizeof(Index *) + _page_count * PAGE_SIZE * sizeof(Index);
+    }
+
+private:
+    static constexpr Index PAGE_BITS = 12;
+    static constexpr Index PAGE_SIZE = 1u << PAGE_BITS;
+
+    std::pmr::vector<Index *> _pages;
+    std::size_t _page_count = 0;
+
+    void ReleasePages() {
+        for (Index *page : _pages) {
+            if (page)
+                _pages.get_allocator().resource()->deallocate(page, PAGE_SIZE * sizeof(Index), alignof(Index));
+        }
+        _pages.clear();
+        _page_count = 0;
+    }
+};
+
+// Memory grows with the amount of entries set at once, not with their values.
+// Slowest lookup, meant for components only a handful of entities have
+class HashSparseIndex {
+public:
+    using Index = std::uint32_t;
+    static constexpr Index INVALID = ~0u;
+    static constexpr bool ERASES_RELEASED = true;
+
+    explicit HashSparseIndex(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : _indices(resource) {}
+
+    Index Get(Index entry) const {
+        auto it = _indices.find(entry);
+        return it != _indices.end() ? it->second : INVALID;
+    }
+
+    void Set(Index entry, Index index) {
+        _indices[entry] = index;
+    }
+
+    // Buckets shrink once most of them are empty, so a burst of entries does not pin them
+    void Erase(Index entry) {
+        _indices.erase(entry);
+        if (_indices.size() * 4 < _indices.bucket_count())
+            _indices.rehash(0);
+    }
+
+    void Reserve(Index capacity) {
+        _indices.reserve(capacity);
+    }
+
+    // Estimate: bucket array plus a node of a key, value and next pointer per entry.
+    // A single bucket is kept inside the map rather than allocated
+    std::size_t GetMemory() const {
+        std::size_t buckets = _indices.bucket_count() > 1 ? _indices.bucket_count() : 0;
+        return buckets * sizeof(void *) + _indices.size() * (sizeof(std::pair<const Index, Index>) + sizeof(void *));
+    }
+
+private:
+    std::pmr::unordered_map<Index, Index> _indices;
+};
@@ -0,0 +1,311 @@
+#pragma once
+#include "memory.hpp"
+#include "packed_array.hpp"
+#include "span.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Storage for components without data: a single bit per entry.
+// Every entry shares the same instance of T
+template<typename T>
+class TagArray {
+    static_assert(std::is_empty_v<T>, "Tag storage is only for components without data");
+
+    using Index = std::uint32_t;
+    using Word = std::uint64_t;
+    static constexpr Index WORD_BITS = 64;
+
+    std::pmr::vector<Word> _bits;
+    Index _count;
+    T _value;
+
+public:
+    explicit TagArray(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : _bits(resource), _count(0) {}
+
+    bool HasData(Index entry) const {
+        Index word = entry / WORD_BITS;
+        return word < _bits.size() && (_bits[word] >> (entry % WORD_BITS) & 1);
+    }
+
+    void RemoveData(Index entry) {
+        assert(HasData(entry) && "Entry does not have valid data to remove");
+        _bits[entry / WORD_BITS] &= ~(Word(1) << (entry % WORD_BITS));
+        _count--;
+    }
+
+    T &GetData(Index entry) {
+        assert(HasData(entry) && "Entry does not have valid data");
+        return _value;
+    }
+
+    T *TryGetData(Index entry) {
+        return HasData(entry) ? &_value : nullptr;
+    }
+
+    void SetData(Index entry, const T &) {
+        EmplaceData(entry);
+    }
+
+    // Tags carry no state, arguments are ignored
+    template<typename ...Args>
+    T &EmplaceData(Index entry, Args &&...) {
+        if (HasData(entry))
+            return _value;
+
+        Index word = entry / WORD_BITS;
+        if (word >= _bits.size())
+            _bits.resize(std::max<std::size_t>(word + 1, _bits.size() * 2), 0);
+        _bits[word] |= Word(1) << (entry % WORD_BITS);
+        _count++;
+        return _value;
+    }
+
+    Index GetSize() const {
+        return _count;
+    }
+
+    Index size() const {
+        return _count;
+    }
+
+    void Reserve(Index capacity) {
+        _bits.reserve((capacity + WORD_BITS - 1) / WORD_BITS);
+    }
+
+    PoolMemory GetMemory() const {
+        return { _bits.capacity() * sizeof(Word), _bits.size() * sizeof(Word) };
+    }
+
+    // Slots are entries themselves, empty words are skipped
+    Index GetSlotCount() const {
+        return _bits.size() * WORD_BITS;
+    }
+
+    template<typename Func>
+    void ForEachInSlots(Index begin, Index end, Func func) {
+        end = std::min(end, GetSlotCount());
+        for (Index word = begin / WORD_BITS; word * WORD_BITS < end; word++) {
+            Word bits = _bits[word];
+            while (bits) {
+                Index entry = word * WORD_BITS + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (entry >= begin && entry < end)
+                    func(entry, _value);
+            }
+        }
+    }
+};
+
+template<typename M>
+struct MemberPointerTraits;
+
+template<typename C, typename F>
+struct MemberPointerTraits<F C::*> {
+    using Class = C;
+    using Field = F;
+};
+
+// Type of the data member Field points to
+template<auto Field>
+using FieldType = typename MemberPointerTraits<decltype(Field)>::Field;
+
+template<auto Field>
+using FieldClass = typename MemberPointerTraits<decltype(Field)>::Class;
+
+// Structure of arrays: every listed field of T gets its own packed column,
+// so kernels touching few fields read only those. Fields which are not listed are not stored.
+// Data is accessed through Reference proxies or whole columns, see GetColumn
+template<typename T, auto ...Fields>
+class SoAArray : public SparseSet<PagedSparseIndex> {
+    static_assert(sizeof...(Fields) > 0, "SoA storage needs at least one field");
+    static_assert((std::is_same_v<FieldClass<Fields>, T> && ...), "Fields have to be members of the component");
+
+    std::tuple<std::pmr::vector<FieldType<Fields>>...> _columns;
+
+public:
+    explicit SoAArray(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : SparseSet<PagedSparseIndex>(resource), _columns(std::pmr::vector<FieldType<Fields>>(resource)...) {}
+
+    // Proxy for one component, valid until the array changes structurally
+    class Reference {
+        SoAArray *_array;
+        Index _index;
+
+    public:
+        Reference(SoAArray *array, Index index) : _array(array), _index(index) {}
+
+        template<auto Field>
+        FieldType<Field> &Get() const {
+            return _array->template GetColumnVector<Field>()[_index];
+        }
+
+        operator T() const {
+            T result {};
+            ((result.*Fields = Get<Fields>()), ...);
+            return result;
+        }
+
+        const Reference &operator=(const T &value) const {
+            ((Get<Fields>() = value.*Fields), ...);
+            return *this;
+        }
+    };
+
+    void RemoveData(Index entry) {
+        Index removed_index = ReleaseEntry(entry);
+        std::apply([&](auto &...columns) {
+            ((removed_index < _entry_count ? void(columns[removed_index] = std::move(columns[_entry_count])) : void()), ...);
+            (columns.pop_back(), ...);
+        }, _columns);
+    }
+
+    Reference GetData(Index entry) {
+        assert(HasData(entry) && "Entry does not have valid data");
+        return Reference(this, GetIndex(entry));
+    }
+
+    void SetData(Index entry, const T &data) {
+        EmplaceData(entry, data);
+    }
+
+    // Builds T from args and scatters its fields into columns
+    template<typename ...Args>
+    Reference EmplaceData(Index entry, Args &&...args) {
+        T value = Make(std::forward<Args>(args)...);
+        Index index = GetIndex(entry);
+
+        if (index < _entry_count) {
+            ((GetColumnVector<Fields>()[index] = std::move(value.*Fields)), ...);
+            return Reference(this, index);
+        }
+
+        ClaimEntry(entry, index);
+        (GetColumnVector<Fields>().push_back(std::move(value.*Fields)), ...);
+        return Reference(this, _entry_count++);
+    }
+
+    // Values of the field for all entries, in the same order as GetEntry
+    template<auto Field>
+    Span<FieldType<Field>> GetColumn() {
+        auto &column = GetColumnVector<Field>();
+        return Span<FieldType<Field>>(column.data(), column.size());
+    }
+
+    // Calls func(entry, reference) for entries stored at internal indices [begin, end)
+    template<typename Func>
+    void ForEachInSlots(Index begin, Index end, Func func) {
+        end = std::min(end, _entry_count);
+        for (Index i = begin; i < end; i++) {
+            Reference reference(this, i);
+            func(_index_to_entry[i], reference);
+        }
+    }
+
+    void Reserve(Index capacity) {
+        std::apply([&](auto &...columns) { (columns.reserve(capacity), ...); }, _columns);
+        ReserveEntries(capacity);
+    }
+
+    PoolMemory GetMemory() const {
+        std::size_t index = GetIndexMemory();
+        PoolMemory memory { index, 0, index };
+        std::apply([&](auto &...columns) {
+            ((memory += { columns.capacity() * sizeof(columns[0]), columns.size() * sizeof(columns[0]) }), ...);
+        }, _columns);
+        return memory;
+    }
+
+private:
+    template<auto A, auto B>
+    static constexpr bool IsSameField() {
+        if constexpr (std::is_same_v<decltype(A), decltype(B)>)
+            return A == B;
+        else
+            return false;
+    }
+
+    template<auto Field>
+    static constexpr std::size_t GetFieldIndex() {
+        std::size_t index = 0;
+        std::size_t result = sizeof...(Fields);
+        ((IsSameField<Fields, Field>() ? result = index : 0, index++), ...);
+        return result;
+    }
+
+    template<auto Field>
+    std::pmr::vector<FieldType<Field>> &GetColumnVector() {
+        static_assert(GetFieldIndex<Field>() < sizeof...(Fields), "Field is not stored by this array");
+        return std::get<GetFieldIndex<Field>()>(_columns);
+    }
+
+    template<typename ...Args>
+    static T Make(Args &&...args) {
+        if constexpr (std::is_constructible_v<T, Args &&...>)
+            return T(std::forward<Args>(args)...);
+        else
+            return T{ std::forward<Args>(args)... };
+    }
+};
+
+// Storage policies. Component picks one with a `using StoragePolicy = ...;` member
+// or a ComponentStoragePolicy specialization, so every access dispatches at compile time.
+// Every Array is constructible from the memory resource its data is allocated from
+
+// Flat sparse index: fastest lookups, for components most entities have
+struct DenseStorage {
+    template<typename T>
+    using Array = PackedArray<T, FlatSparseIndex, PoolAllocator<T>>;
+};
+
+// Paged sparse index: default for components with data
+struct PagedStorage {
+    template<typename T>
+    using Array = PackedArray<T, PagedSparseIndex, PoolAllocator<T>>;
+};
+
+// Hashed sparse index: for components only a handful of entities ever have
+struct HashStorage {
+    template<typename T>
+    using Array = PackedArray<T, HashSparseIndex, PoolAllocator<T>>;
+};
+
+// Column per listed field: for components iterated field by field
+template<auto ...Fields>
+struct SoAStorage {
+    template<typename T>
+    using Array = SoAArray<T, Fields...>;
+};
+
+// Bit per entity: default for empty components
+struct TagStorage {
+    template<typename T>
+    using Array = TagArray<T>;
+};
+
+template<typename T, typename = void>
+struct ComponentStoragePolicy {
+    using type = std::conditional_t<std::is_empty_v<T>, TagStorage, PagedStorage>;
+};
+
+template<typename T>
+struct ComponentStoragePolicy<T, std::void_t<typename T::StoragePolicy>> {
+    using type = typename T::StoragePolicy;
+};
+
+template<typename T>
+using ComponentStorage = typename ComponentStoragePolicy<T>::type::template Array<T>;
+
+// Policies whose Array hands out proxies rather than T&. Archetype chunks only store whole T,
+// so code written against the proxies would not compile the same way there
+template<typename Policy>
+inline constexpr bool IS_PROXY_STORAGE = false;
+
+template<auto ...Fields>
+inline constexpr bool IS_PROXY_STORAGE<SoAStorage<Fields...>> = true;
@@ -2,17 +2,26 @@
 
 #include <vector>
 #include <array>
-#include <bitset>
 #include <cassert>
+#include <type_traits>
 #include "entity.hpp"
+#include "component.hpp"
+#include "query.hpp"
+#include "span.hpp"
 
 class Engine;
 
 class System {
 protected:
     Engine& _engine;
-    std::vector<std::vector<Entity>> _targets;
-    std::vector<std::bitset<MAX_ENTITIES>> _current_entities;
+    // Entities matching each signature, keyed by entity index
+    std::vector<PackedArray<Entity>> _targets;
+    // Per signature with optional terms: targets in [0, _split) have all of its optional components.
+    // Stays 0 for the rest, see GetSplit
+    std::vector<std::uint32_t> _split;
+    bool _stable_order = false;
+    Tick _run_tick = 0;
+    Tick _last_run_tick = 0;
 
     void ValidateSignatureID(size_t id) const{
         assert(id >= 0 && id < GetSignatureCount() && "Signature ID is out of bounds");
@@ -29,12 +38,74 @@ protected:
         AddSignature(signature, signature_id);
     }
 
+    // With, Without and Optional terms. Any-of terms are only for ad-hoc queries
+    void AddSignature(const Query &query, unsigned int *signature_id) {
+        assert(query.any_of.IsEmpty() && "System signatures do not support any-of terms");
+        exclusions[*signature_id] = query.exclude;
+        optionals[*signature_id] = query.optional;
+        AddSignature(Signature(query.include), signature_id);
+    }
+
+    // Targets are iterated in the order they were added. Makes removal O(n)
+    void KeepInsertionOrder() {
+        _stable_order = true;
+    }
+
+    // Declare components accessed in Update so engine can run non-conflicting systems in parallel.
+    // System which declares nothing is assumed to touch everything. const T declares T
+    template<typename ...Ts>
+    void Reads() {
+        (reads.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+        declares_access = true;
+    }
+
+    template<typename ...Ts>
+    void Writes() {
+        (writes.AddComponent(component_type_id<std::remove_const_t<Ts>>), ...);
+        declares_access = true;
+    }
+
+    // Run on every period-th simulation step only, on steps where step % period == phase.
+    // Update then gets the time of all period steps, so dt-based integration keeps real time.
+    // Without a phase, engine staggers systems of the same period across different steps
+    void RunEvery(unsigned int period, unsigned int phase) {
+        assert(period > 0 && phase < period && "Phase has to be less than period");
+        run_period = period;
+        run_phase = phase;
+        stagger = false;
+    }
+
+    void RunEvery(unsigned int period) {
+        assert(period > 0 && "Period has to be positive");
+        run_period = period;
+        stagger = true;
+    }
+
+    // Run once per Engine::Update with the frame's dt instead of on every simulation step,
+    // e.g. rendering. See Engine::SetFixedTimestep
+    void RunPerFrame() {
+        per_frame = true;
+    }
+
 public:
+    // Components targets of each signature have
     std::vector<Signature> signatures;
+    // Components they must not have
+    std::vector<Signature> exclusions;
+    // Components splitting targets into two parts, see GetTargetsWithOptional
+    std::vector<Signature> optionals;
+    Signature reads;
+    Signature writes;
+    bool declares_access = false;
+    unsigned int run_period = 1;
+    unsigned int run_phase = 0;
+    bool stagger = false;
+    bool per_frame = false;
 
 	template<typename ...Signatures>
     System(Engine& engine, Signatures... signatures) 
-        : _engine(engine), _targets(sizeof...(Signatures)), _current_entities(sizeof...(Signatures)), signatures(sizeof...(Signatures)) {
+        : _engine(engine), _targets(sizeof...(Signatures)), _split(sizeof...(Signatures)),
+          signatures(sizeof...(Signatures)), exclusions(sizeof...(Signatures)), optionals(sizeof...(Signatures)) {
 
 		unsigned int signature_id = 0u;
 		(AddSignature(signatures, &signature_id), ...);
@@ -42,29 +113,129 @@ public:
 
     void AddEntity(Entity entity, size_t type) {
         assert(!IsEntityProccessed(entity, type) && "This entity has already been added");
-        
-        _targets[type].push_back(entity);
-        _current_entities[type].set(entity);
+
+        _targets[type].SetData(GetEntityIndex(entity), entity);
+    }
+
+    void AddEntities(Span<const Entity> entities, size_t type) {
+        _targets[type].Reserve(_targets[type].size() + entities.size());
+        for (Entity entity : entities)
+            AddEntity(entity, type);
     }
 
+    // Same as above, signature of the entity decides which part of targets it goes to
+    void AddEntity(Entity entity, size_t type, const Signature &signature) {
+        AddEntity(entity, type);
+        UpdateSplit(entity, type, signature);
+    }
+
+    // Every entity has the signature
+    void AddEntities(Span<const Entity> entities, size_t type, const Signature &signature) {
+        AddEntities(entities, type);
+        if (!optionals[type].IsEmpty() && signature.IsSufficientFor(optionals[type])) {
+            for (Entity entity : entities)
+                UpdateSplit(entity, type, signature);
+        }
+    }
+
+    // Moves a target between parts after its optional components changed
+    void UpdateSplit(Entity entity, size_t type, const Signature &signature) {
+        if (optionals[type].IsEmpty())
+            return;
+        assert(!_stable_order && "Optional terms reorder targets");
+
+        PackedArray<Entity> &targets = _targets[type];
+        std::uint32_t position = targets.GetInternalIndex(GetEntityIndex(entity));
+        bool has_optional = signature.IsSufficientFor(optionals[type]);
+        if (has_optional && position >= _split[type]) {
+            targets.SwapSlots(position, _split[type]);
+            _split[type]++;
+        } else if (!has_optional && position < _split[type]) {
+            _split[type]--;
+            targets.SwapSlots(position, _split[type]);
+        }
+    }
+
+    // Entity with the signature belongs to targets of the type
+    bool Accepts(size_t type, const Signature &signature) const {
+        return signature.IsSufficientFor(signatures[type]) && !signature.Intersects(exclusions[type]);
+    }
+
+    // O(1) swap with the last target unless system keeps insertion order
     void RemoveEntity(Entity entity, size_t type) {
         assert(IsEntityProccessed(entity, type) && "This entity hadn't been added");
 
-        auto it = _targets[type].begin();
-        for (; *it != entity; ++it);
+        // Leave the optional part first, so the swap below keeps both parts packed
+        std::uint32_t position = _targets[type].GetInternalIndex(GetEntityIndex(entity));
+        if (position < _split[type]) {
+            _split[type]--;
+            _targets[type].SwapSlots(position, _split[type]);
+        }
+
+        if (_stable_order)
+            _targets[type].RemoveDataOrdered(GetEntityIndex(entity));
+        else
+            _targets[type].RemoveData(GetEntityIndex(entity));
+    }
+
+    // Frame arena of the calling thread, reset at the start of every Engine::Update.
+    // Defined in engine.hpp
+    FrameArena &GetScratch();
+
+    // Tick of the previous run. Changes stamped after it happened since then,
+    // excluding ones made by this system during that run
+    Tick GetLastRunTick() const {
+        return _last_run_tick;
+    }
+
+    // Called by the engine as the tick advances, see ClampTick
+    void ClampTicks(Tick now) {
+        _run_tick = ClampTick(_run_tick, now);
+        _last_run_tick = ClampTick(_last_run_tick, now);
+    }
 
-        _current_entities[type].reset(*it);
-        _targets[type].erase(it);
+    // Targets having every optional component of the signature, iterated with no membership checks.
+    // All of them when the signature has no optional terms
+    Span<const Entity> GetTargetsWithOptional(size_t type) const {
+        return Span<const Entity>(_targets[type].entries.data(), GetSplit(type));
+    }
+
+    // Targets missing some optional component of the signature
+    Span<const Entity> GetTargetsWithoutOptional(size_t type) const {
+        return Span<const Entity>(_targets[type].entries.data() + GetSplit(type), _targets[type].size() - GetSplit(type));
+    }
+
+    // Every target trivially has all of an empty set of optional components
+    std::uint32_t GetSplit(size_t type) const {
+        return optionals[type].IsEmpty() ? _targets[type].size() : _split[type];
     }
 
     bool IsEntityProccessed(Entity entity, size_t type) const {
         ValidateSignatureID(type);
-        return _current_entities[type].test(entity);
+        return _targets[type].HasData(GetEntityIndex(entity));
+    }
+
+    bool IsDue(std::uint64_t step) const {
+        return step % run_period == run_phase;
     }
 
     size_t GetSignatureCount() const {
         return _targets.size();
     }
 
+    // Calls func(Entity) for targets of the signature, split into chunks over engine's thread pool.
+    // Defined in engine.hpp
+    template<typename Func>
+    void ParallelForEach(size_t type, Func func, size_t grain = 1024);
+
     void virtual Update(float dt) = 0;
+
+    // Calls Update and advances engine's tick. Defined in engine.hpp
+    void Run(float dt);
+
+    // Same as Run with S::Update called directly instead of through the vtable
+    template<typename S>
+    void RunAs(float dt);
+
+    virtual ~System() = default;
 };
@@ -1,4 +1,232 @@
 #pragma once
 
-template<typename T>
-class View
+#include "component.hpp"
+#include "entity.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Calls func(Entity, Ts&...) or func(Ts&...) depending on what it accepts
+template<typename Func, typename ...Ts>
+inline void InvokeWithEntity(Func &func, Entity entity, Ts &...components) {
+    if constexpr (std::is_invocable_v<Func &, Entity, Ts &...>)
+        func(entity, components...);
+    else
+        func(components...);
+}
+
+// Joins several component arrays of any storage policy.
+// Iteration is driven by the smallest array, the rest are probed with a single lookup per entity.
+// With a single component type it is a plain walk over its storage.
+// Components which are not const are stamped as changed for every visited entity
+template<typename ...Ts>
+class View {
+    static_assert(sizeof...(Ts) > 0, "View needs at least one component type");
+
+    template<typename T>
+    using ArrayOf = ComponentArray<std::remove_const_t<T>>;
+
+    std::tuple<ArrayOf<Ts> *...> _arrays;
+    const PackedArray<Signature> *_signatures;
+    const std::vector<EntityGeneration> *_generations;
+    Tick _tick;
+    // Entity is visited only if its components changed and were added after these ticks, where set
+    std::array<Tick, sizeof...(Ts)> _changed_since {};
+    std::array<Tick, sizeof...(Ts)> _added_since {};
+    std::array<bool, sizeof...(Ts)> _has_changed_since {};
+    std::array<bool, sizeof...(Ts)> _has_added_since {};
+    // Entity is skipped if it has any of these
+    Signature _excluded;
+    bool _filtered = false;
+
+public:
+    View(const PackedArray<Signature> &signatures, const std::vector<EntityGeneration> &generations, Tick tick, ArrayOf<Ts> &...arrays)
+        : _arrays(&arrays...), _signatures(&signatures), _generations(&generations), _tick(tick) {}
+
+    // Skip entities having any of Us
+    template<typename ...Us>
+    View &Without() {
+        (_excluded.AddComponent(component_type_id<Us>), ...);
+        _filtered = true;
+        return *this;
+    }
+
+    // Only visit entities whose T changed after tick
+    template<typename T>
+    View &ChangedSince(Tick tick) {
+        static_assert(IndexOf<T>() < sizeof...(Ts), "Component is not part of the view");
+        static_assert(ComponentTracksChanges<std::remove_const_t<T>>::value, "Component does not track changes, see ComponentTracksChanges");
+        _changed_since[IndexOf<T>()] = tick;
+        _has_changed_since[IndexOf<T>()] = true;
+        _filtered = true;
+        return *this;
+    }
+
+    // Only visit entities which got T after tick
+    template<typename T>
+    View &AddedSince(Tick tick) {
+        static_assert(IndexOf<T>() < sizeof...(Ts), "Component is not part of the view");
+        static_assert(ComponentTracksChanges<std::remove_const_t<T>>::value, "Component does not track changes, see ComponentTracksChanges");
+        _added_since[IndexOf<T>()] = tick;
+        _has_added_since[IndexOf<T>()] = true;
+        _filtered = true;
+        return *this;
+    }
+
+    // Upper bound on the amount of entities ForEach visits
+    std::uint32_t GetSizeHint() const {
+        return GetSizeHint(std::index_sequence_for<Ts...>());
+    }
+
+    template<typename Func>
+    void ForEach(Func func) {
+        std::size_t driver = GetSmallestArray(std::index_sequence_for<Ts...>());
+        IterateRange(func, driver, 0, ~0u, std::index_sequence_for<Ts...>());
+    }
+
+    // Splits the driving array into chunks of `grain` entities and runs them on the pool.
+    // Func must be safe to call concurrently, use PerWorker for scratch data
+    template<typename Func>
+    void ParallelForEach(ThreadPool *pool, Func func, std::uint32_t grain = 1024) {
+        if (!pool) {
+            ForEach(func);
+            return;
+        }
+
+        std::size_t driver = GetSmallestArray(std::index_sequence_for<Ts...>());
+        std::uint32_t slots = GetSlotCount(driver, std::index_sequence_for<Ts...>());
+        pool->ParallelFor(slots, grain, [&](std::size_t begin, std::size_t end) {
+            IterateRange(func, driver, begin, end, std::index_sequence_for<Ts...>());
+        });
+    }
+
+    // Field column of an SoA component, in the order of its array's GetEntry.
+    // Columns of different components are not aligned with each other. Not stamped as changed
+    template<auto Field>
+    Span<FieldType<Field>> GetColumn() {
+        return std::get<ComponentArray<FieldClass<Field>> *>(_arrays)->template GetColumn<Field>();
+    }
+
+private:
+    Entity GetEntity(EntityIndex index) const {
+        return MakeEntity(index, (*_generations)[index]);
+    }
+
+    template<typename T>
+    static constexpr std::size_t IndexOf() {
+        std::size_t index = 0;
+        std::size_t result = sizeof...(Ts);
+        ((std::is_same_v<std::remove_const_t<Ts>, std::remove_const_t<T>> ? result = index : 0, index++), ...);
+        return result;
+    }
+
+    template<std::size_t ...Is>
+    bool PassesFilters(EntityIndex index, std::index_sequence<Is...>) const {
+        if (!_excluded.IsEmpty() && _signatures->entries[_signatures->GetInternalIndex(index)].Intersects(_excluded))
+            return false;
+        return (PassesTickFilters<Is>(index) && ...);
+    }
+
+    template<std::size_t I>
+    bool PassesTickFilters(EntityIndex index) const {
+        using T = std::remove_const_t<std::tuple_element_t<I, std::tuple<Ts...>>>;
+        if constexpr (ComponentTracksChanges<T>::value) {
+            const ChangeTicks &ticks = std::get<I>(_arrays)->ticks;
+            return (!_has_changed_since[I] || IsNewerTick(ticks.GetChangedTick(index), _changed_since[I])) &&
+                (!_has_added_since[I] || IsNewerTick(ticks.GetAddedTick(index), _added_since[I]));
+        } else {
+            return true;
+        }
+    }
+
+    template<std::size_t I>
+    void Stamp(EntityIndex index) {
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if constexpr (!std::is_const_v<T>)
+            std::get<I>(_arrays)->ticks.MarkChanged(index, _tick);
+    }
+
+    template<typename Func, typename ...Cs, std::size_t ...Is>
+    void Visit(Func &func, EntityIndex index, std::index_sequence<Is...> sequence, Cs &...components) {
+        if (_filtered && !PassesFilters(index, sequence))
+            return;
+        InvokeWithEntity(func, GetEntity(index), components...);
+        (Stamp<Is>(index), ...);
+    }
+
+    template<std::size_t ...Is>
+    std::uint32_t GetSizeHint(std::index_sequence<Is...>) const {
+        std::uint32_t result = ~0u;
+        ((result = std::min(result, std::get<Is>(_arrays)->GetSize())), ...);
+        return result;
+    }
+
+    template<std::size_t ...Is>
+    std::size_t GetSmallestArray(std::index_sequence<Is...>) const {
+        std::size_t driver = 0;
+        std::uint32_t smallest = ~0u;
+        ((std::get<Is>(_arrays)->GetSize() < smallest ? (smallest = std::get<Is>(_arrays)->GetSize(), driver = Is) : 0), ...);
+        return driver;
+    }
+
+    // Positions of the driving array are split between workers
+    template<std::size_t ...Is>
+    std::uint32_t GetSlotCount(std::size_t driver, std::index_sequence<Is...>) const {
+        std::uint32_t result = 0;
+        ((driver == Is ? (result = std::get<Is>(_arrays)->GetSlotCount()) : 0), ...);
+        return result;
+    }
+
+    template<typename Func, std::size_t ...Is>
+    void IterateRange(Func &func, std::size_t driver, std::uint32_t begin, std::uint32_t end, std::index_sequence<Is...> sequence) {
+        ((driver == Is ? IterateDrivenBy<Is>(func, begin, end, sequence) : void()), ...);
+    }
+
+    // Driving array is already positioned on the entity, others need a lookup
+    template<std::size_t I, std::size_t Driver, typename D>
+    auto *Probe(D &driving_data, EntityIndex index) {
+        if constexpr (I == Driver)
+            return &driving_data;
+        else
+            return std::get<I>(_arrays)->TryGetData(index);
+    }
+
+    template<std::size_t Driver, typename Func, std::size_t ...Is>
+    void IterateDrivenBy(Func &func, std::uint32_t begin, std::uint32_t end, std::index_sequence<Is...>) {
+        auto &driving = *std::get<Driver>(_arrays);
+
+        // Single component - plain walk over driving storage
+        if constexpr (sizeof...(Ts) == 1) {
+            using T = std::tuple_element_t<0, std::tuple<Ts...>>;
+            driving.ForEachInSlots(begin, end, [&](EntityIndex index, auto &data) {
+                if constexpr (!std::is_const_v<T>) {
+                    Visit(func, index, std::index_sequence<Is...>(), data);
+                } else if constexpr (std::is_same_v<std::decay_t<decltype(data)>, std::remove_const_t<T>>) {
+                    Visit(func, index, std::index_sequence<Is...>(), std::as_const(data));
+                } else {
+                    // SoA proxies write through even when const, so readers get the fields gathered
+                    const std::remove_const_t<T> value = data;
+                    Visit(func, index, std::index_sequence<Is...>(), value);
+                }
+            });
+        } else {
+            static_assert((std::is_same_v<decltype(std::declval<ArrayOf<Ts> &>().GetData(0)), std::remove_const_t<Ts> &> && ...),
+                "SoA components can only be joined through GetColumn");
+
+            driving.ForEachInSlots(begin, end, [&](EntityIndex index, auto &data) {
+                std::tuple<Ts *...> components;
+
+                bool matched = ((std::get<Is>(components) = Probe<Is, Driver>(data, index)) && ...);
+
+                if (matched)
+                    Visit(func, index, std::index_sequence<Is...>(), *std::get<Is>(components)...);
+            });
+        }
+    }
+};
@@ -118,12 +118,33 @@ Renderer::Renderer(
         Vector2Int window_size,
         const char *window_name,
         unsigned int buffer_size=6)
-		:   System(engine, engine.ConstructSignature<Triangle>(), engine.ConstructSignature<Rectangle>()),
+		:   System(engine, Query().With<Triangle>().Optional<Transform>(), Query().With<Rectangle>().Optional<Transform>()),
             _vertex_buffer(buffer_size), 
             _index_buffer(buffer_size) {
 
 	PROFILE_FUNCTION();
 
+	// Draws at display rate, between the last two simulation steps
+	RunPerFrame();
+	Reads<Triangle, Rectangle, Transform>();
+	// Transform stays untouched, so ChangedSince<Transform> only sees real moves
+	engine.OnStep([this](float) {
+		for (auto type = 0u; type < GetSignatureCount(); type++) {
+			for (auto entity : GetTargetsWithOptional(type))
+				SnapshotPosition(entity);
+		}
+	});
+	// Shapes start where they are rather than at a position left by an earlier target
+	auto snapshot_added = [this](Span<const Entity> added) {
+		for (Entity entity : added) {
+			if (_engine.IsAlive(entity) && _engine.GetSignature(entity).Has(_engine.GetComponentID<Transform>()))
+				SnapshotPosition(entity);
+		}
+	};
+	engine.Observe<Transform>(ComponentEvent::Add, snapshot_added, ObserverPhase::SyncPoint);
+	engine.Observe<Triangle>(ComponentEvent::Add, snapshot_added, ObserverPhase::SyncPoint);
+	engine.Observe<Rectangle>(ComponentEvent::Add, snapshot_added, ObserverPhase::SyncPoint);
+
 	_window = nullptr;
 	assert(glfwInit() && "GLFW was not able to initialize");
 
@@ -161,18 +182,35 @@ Renderer::~Renderer() {
 	glfwTerminate();
 }
 
+void Renderer::SnapshotPosition(Entity entity) {
+	EntityIndex index = GetEntityIndex(entity);
+	if (index >= _previous_positions.size())
+		_previous_positions.resize(index + 1);
+	_previous_positions[index] = { entity, _engine.ReadComponent<Transform>(entity).position };
+}
+
+Vector3 Renderer::Interpolate(Entity entity, float alpha) const {
+	Vector3 position = _engine.ReadComponent<Transform>(entity).position;
+	EntityIndex index = GetEntityIndex(entity);
+	// Not snapshotted since it got a transform, so it has not moved yet
+	if (index >= _previous_positions.size() || _previous_positions[index].entity != entity)
+		return position;
+	Vector3 previous = _previous_positions[index].position;
+	return previous + (position - previous) * alpha;
+}
+
 void Renderer::Update(float dt) {
 	PROFILE_FUNCTION();
-    auto triangles = _engine.GetComponentArray<Triangle>();
-    auto rectangles = _engine.GetComponentArray<Rectangle>();
-    auto transforms = _engine.GetComponentArray<Transform>();
+    auto triangle_count = GetTargetsWithOptional(0).size() + GetTargetsWithoutOptional(0).size();
+    auto rectangle_count = GetTargetsWithOptional(1).size() + GetTargetsWithoutOptional(1).size();
 
-    _vertex_buffer.Reserve((triangles.size()*3 + rectangles.size()*4) * 5);
-    _index_buffer.Reserve(triangles.size()*3 + rectangles.size()*6);
+    _vertex_buffer.Reserve((triangle_count*3 + rectangle_count*4) * 5);
+    _index_buffer.Reserve(triangle_count*3 + rectangle_count*6);
 
     _vertex_buffer.Empty();
     _index_buffer.Empty();
     auto current_index = 0u;
+    float alpha = _engine.GetInterpolationAlpha();
     
     auto bufferVertex = [&](Vector3 vertex, Vector3 color) {
         _vertex_buffer.Append(vertex.x / _window_size.x);
@@ -183,17 +221,13 @@ void Renderer::Update(float dt) {
         return current_index++;	
     };
     
-    for (auto entity : _targets[0]) {
-        auto &triangle = triangles.GetData(entity);
-        Vector3 position = transforms.HasData(entity) ? transforms.GetData(entity).position : (Vector3){0,0,0};
+    auto bufferTriangle = [&](const Triangle &triangle, Vector3 position) {
         for (auto &vertex : triangle.vertices) {
             _index_buffer.Append(bufferVertex(vertex + position, triangle.color));
         }
-    }
+    };
 
-    for (auto entity : _targets[1]) {
-        auto &rectangle = rectangles.GetData(entity);
-        Vector3 position = transforms.HasData(entity) ? transforms.GetData(entity).position : (Vector3){0,0,0};
+    auto bufferRectangle = [&](const Rectangle &rectangle, Vector3 position) {
         auto i0 = bufferVertex(rectangle.vertices[0] + position, rectangle.color);
         auto i1 = bufferVertex(rectangle.vertices[1] + position, rectangle.color);
         auto i2 = bufferVertex(rectangle.vertices[2] + position, rectangle.color);
@@ -206,13 +240,27 @@ void Renderer::Update(float dt) {
         _index_buffer.Append(i0);
         _index_buffer.Append(i2);
         _index_buffer.Append(i3);
+    };
+
+    // Shapes with a transform come first in targets, so neither loop checks for it
+    for (auto entity : GetTargetsWithOptional(0)) {
+        bufferTriangle(_engine.ReadComponent<Triangle>(entity), Interpolate(entity, alpha));
+    }
+    for (auto entity : GetTargetsWithoutOptional(0)) {
+        bufferTriangle(_engine.ReadComponent<Triangle>(entity), (Vector3){0,0,0});
+    }
+    for (auto entity : GetTargetsWithOptional(1)) {
+        bufferRectangle(_engine.ReadComponent<Rectangle>(entity), Interpolate(entity, alpha));
+    }
+    for (auto entity : GetTargetsWithoutOptional(1)) {
+        bufferRectangle(_engine.ReadComponent<Rectangle>(entity), (Vector3){0,0,0});
     }
     GLCall(glBufferData(GL_ARRAY_BUFFER, _vertex_buffer.size * sizeof(float), _vertex_buffer.data, GL_DYNAMIC_DRAW));
     GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, _index_buffer.size * sizeof(unsigned int), _index_buffer.data, GL_DYNAMIC_DRAW)); 
 
     glClear(GL_COLOR_BUFFER_BIT);
 
-    GLCall(glDrawElements(GL_TRIANGLES, triangles.size()*3 + rectangles.size()*6, GL_UNSIGNED_INT, nullptr));
+    GLCall(glDrawElements(GL_TRIANGLES, triangle_count*3 + rectangle_count*6, GL_UNSIGNED_INT, nullptr));
 
     glfwSwapBuffers(_window);
     GLCall(glFlush());
@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 class Engine;
+
 struct Triangle {
 	Vector3 vertices[3];
 	Vector3 color;
@@ -59,8 +60,19 @@ public:
 	~Renderer();
 	void Update(float dt);
 private:
+	// Position of an entity at the start of the current simulation step, for interpolation
+	struct PreviousPosition {
+		Entity entity;
+		Vector3 position;
+	};
+
+	void SnapshotPosition(Entity entity);
+	Vector3 Interpolate(Entity entity, float alpha) const;
+
 	GLFWwindow *_window;
 	Vector2Int _window_size;
 	Buffer<float> _vertex_buffer;
 	Buffer<unsigned int> _index_buffer;
+	// Keyed by entity index, an entry of another generation is stale
+	std::vector<PreviousPosition> _previous_positions;
 };
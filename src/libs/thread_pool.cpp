@@ -0,0 +1,170 @@
+#include "thread_pool.hpp"
+
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local unsigned int current_worker = 0;
+static thread_local std::uint64_t current_task_key = 0;
+
+ThreadPool::ThreadPool(unsigned int thread_count)
+	: _queued(0), _pending(0), _next_queue(0), _waiting(0), _stopping(false) {
+	if (thread_count == 0)
+		thread_count = 1;
+
+	for (unsigned int i = 0; i < thread_count; i++)
+		_queues.push_back(std::make_unique<WorkerQueue>());
+
+	for (unsigned int i = 0; i < thread_count; i++)
+		_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(_sleep_mutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+
+	for (auto &worker : _workers)
+		worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job) {
+	unsigned int index = GetWorkerIndex();
+	if (index == _queues.size())
+		index = _next_queue.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+
+	_pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+		_queues[index]->PushBack(std::move(job));
+	}
+	_queued.fetch_add(1, std::memory_order_release);
+
+	// Taking the lock ensures a worker checking for work either sees the job or gets the notification
+	{
+		std::lock_guard<std::mutex> lock(_sleep_mutex);
+	}
+	_wake.notify_one();
+}
+
+void ThreadPool::Wait() {
+	WaitUntil([this]() { return _pending.load(std::memory_order_acquire) == 0; });
+}
+
+unsigned int ThreadPool::GetThreadCount() const {
+	return _workers.size();
+}
+
+unsigned int ThreadPool::GetWorkerIndex() const {
+	return current_pool == this ? current_worker : _queues.size();
+}
+
+std::uint64_t ThreadPool::GetTaskKey() {
+	return current_task_key;
+}
+
+void ThreadPool::SetTaskKey(std::uint64_t key) {
+	current_task_key = key;
+}
+
+void ThreadPool::WorkerLoop(unsigned int index) {
+	current_pool = this;
+	current_worker = index;
+
+	while (true) {
+		if (TryRunJob(index))
+			continue;
+
+		std::unique_lock<std::mutex> lock(_sleep_mutex);
+		_wake.wait(lock, [this]() { return _stopping || _queued.load(std::memory_order_acquire) > 0; });
+		if (_stopping)
+			return;
+	}
+}
+
+bool ThreadPool::TryRunJob(unsigned int index) {
+	std::function<void()> job;
+	if (!TryPop(index, job))
+		return false;
+
+	job();
+
+	// Somebody may be waiting for exactly this job to finish
+	bool finished_all = _pending.fetch_sub(1, std::memory_order_seq_cst) == 1;
+	if (finished_all || _waiting.load(std::memory_order_seq_cst) > 0) {
+		std::lock_guard<std::mutex> lock(_sleep_mutex);
+		_wake.notify_all();
+	}
+	return true;
+}
+
+bool ThreadPool::TryPop(unsigned int index, std::function<void()> &job) {
+	if (_queued.load(std::memory_order_acquire) == 0)
+		return false;
+
+	// Own queue first, newest job is the one most likely to be in cache
+	if (index < _queues.size()) {
+		WorkerQueue &queue = *_queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.count) {
+			job = queue.PopBack();
+			_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Steal oldest job from somebody else
+	unsigned int start = index < _queues.size() ? index + 1 : 0;
+	for (unsigned int i = 0; i < _queues.size(); i++) {
+		WorkerQueue &queue = *_queues[(start + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.count) {
+			job = queue.PopFront();
+			_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::WorkerQueue::PushBack(std::function<void()> &&job) {
+	if (count == jobs.size()) {
+		std::vector<std::function<void()>> grown(std::max<std::size_t>(jobs.size() * 2, 16));
+		for (std::size_t i = 0; i < count; i++)
+			grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+		jobs.swap(grown);
+		head = 0;
+	}
+	jobs[(head + count) % jobs.size()] = std::move(job);
+	count++;
+}
+
+std::function<void()> ThreadPool::WorkerQueue::PopBack() {
+	count--;
+	return std::move(jobs[(head + count) % jobs.size()]);
+}
+
+std::function<void()> ThreadPool::WorkerQueue::PopFront() {
+	std::function<void()> job = std::move(jobs[head]);
+	head = (head + 1) % jobs.size();
+	count--;
+	return job;
+}
+
+void ThreadPool::WaitUntil(const std::function<bool()> &done) {
+	unsigned int index = GetWorkerIndex();
+	while (!done()) {
+		if (TryRunJob(index))
+			continue;
+
+		_waiting.fetch_add(1, std::memory_order_seq_cst);
+		{
+			std::unique_lock<std::mutex> lock(_sleep_mutex);
+			_wake.wait(lock, [&]() {
+				return _queued.load(std::memory_order_acquire) > 0 || done();
+			});
+		}
+		_waiting.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
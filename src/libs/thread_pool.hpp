@@ -0,0 +1,150 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker owns a queue, pops its own jobs from the back
+// and steals from the front of other queues when it runs dry
+class ThreadPool {
+public:
+	ThreadPool(unsigned int thread_count = std::thread::hardware_concurrency());
+
+	~ThreadPool();
+
+	// Jobs may submit other jobs. Job submitted by a worker goes to its own queue
+	void Submit(std::function<void()> job);
+
+	// Blocks until every submitted job, including ones submitted by jobs, has finished.
+	// Calling thread executes jobs while waiting
+	void Wait();
+
+	unsigned int GetThreadCount() const;
+
+	// [0, GetThreadCount()) for pool workers, GetThreadCount() for any other thread
+	unsigned int GetWorkerIndex() const;
+
+	// Identifies the task the calling thread runs, whichever thread that is, so results recorded
+	// by tasks can be ordered the same way on every run. ParallelFor chunks get the key of the
+	// calling task shifted up, plus their position. 0 outside of keyed tasks
+	static std::uint64_t GetTaskKey();
+
+	static void SetTaskKey(std::uint64_t key);
+
+	// Calls func(begin, end) for chunks of [0, count) no larger than grain.
+	// Safe to call from inside a job: waiting thread keeps executing jobs
+	template<typename Func>
+	void ParallelFor(std::size_t count, std::size_t grain, Func func) {
+		if (count == 0)
+			return;
+		grain = std::max<std::size_t>(grain, 1);
+
+		struct Context {
+			Func &func;
+			std::size_t count;
+			std::size_t grain;
+			std::uint64_t key;
+			std::atomic<std::size_t> remaining;
+		};
+
+		std::size_t chunks = (count + grain - 1) / grain;
+		Context context { func, count, grain, GetTaskKey() << 32, { chunks } };
+		Context *shared = &context;
+
+		for (std::size_t chunk = 0; chunk < chunks; chunk++) {
+			Submit([shared, chunk]() {
+				std::uint64_t key = GetTaskKey();
+				SetTaskKey(shared->key | (chunk + 1));
+				std::size_t begin = chunk * shared->grain;
+				shared->func(begin, std::min(shared->count, begin + shared->grain));
+				SetTaskKey(key);
+				shared->remaining.fetch_sub(1, std::memory_order_seq_cst);
+			});
+		}
+
+		WaitUntil([shared]() { return shared->remaining.load(std::memory_order_acquire) == 0; });
+	}
+
+	// Result does not depend on thread count or timing:
+	// partial results of chunks are combined in chunk order on the calling thread
+	template<typename T, typename Map, typename Combine>
+	T ParallelReduce(std::size_t count, std::size_t grain, T identity, Map map, Combine combine) {
+		grain = std::max<std::size_t>(grain, 1);
+		std::vector<T> partial((count + grain - 1) / grain, identity);
+
+		ParallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+			partial[begin / grain] = map(begin, end);
+		});
+
+		T result = identity;
+		for (auto &value : partial)
+			result = combine(result, value);
+		return result;
+	}
+
+private:
+	// Ring buffer which only grows, so once it fits the usual amount of jobs
+	// submitting them does not allocate
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::vector<std::function<void()>> jobs;
+		std::size_t head = 0;
+		std::size_t count = 0;
+
+		void PushBack(std::function<void()> &&job);
+		std::function<void()> PopBack();
+		std::function<void()> PopFront();
+	};
+
+	void WorkerLoop(unsigned int index);
+
+	bool TryRunJob(unsigned int index);
+
+	bool TryPop(unsigned int index, std::function<void()> &job);
+
+	void WaitUntil(const std::function<bool()> &done);
+
+	std::vector<std::unique_ptr<WorkerQueue>> _queues;
+	std::vector<std::thread> _workers;
+	std::atomic<unsigned int> _queued;
+	std::atomic<unsigned int> _pending;
+	std::atomic<unsigned int> _next_queue;
+	std::atomic<unsigned int> _waiting;
+	std::mutex _sleep_mutex;
+	std::condition_variable _wake;
+	bool _stopping;
+};
+
+// Scratch value per worker, padded so workers do not share cache lines.
+// Works without a pool too, then there is a single slot
+template<typename T>
+class PerWorker {
+	struct alignas(64) Slot {
+		T value;
+	};
+
+	ThreadPool *_pool;
+	std::vector<Slot> _slots;
+
+public:
+	PerWorker(ThreadPool *pool, const T &initial = T())
+		: _pool(pool), _slots(pool ? pool->GetThreadCount() + 1 : 1, Slot { initial }) {}
+
+	T &Local() {
+		return _slots[_pool ? _pool->GetWorkerIndex() : 0].value;
+	}
+
+	std::size_t size() const {
+		return _slots.size();
+	}
+
+	T &operator[](std::size_t i) {
+		return _slots[i].value;
+	}
+};
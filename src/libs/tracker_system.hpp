@@ -57,6 +57,13 @@ public:
         return tmp;
     }
 
+    // Copies the samples into memory, e.g. the frame arena, and keeps the buffer for reuse
+    std::pmr::vector<std::pair<T, K>> Pop(std::pmr::memory_resource *memory) {
+		std::pmr::vector<std::pair<T, K>> tmp(_data.begin(), _data.end(), memory);
+		Reset();
+        return tmp;
+    }
+
     void Reset() {
         _data.clear();
     }
@@ -0,0 +1,122 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+#include <vector>
+
+struct Position {
+    int value;
+};
+
+struct Velocity {
+    int value;
+};
+
+struct Frozen {};
+
+// Targets of a signature with, and without, its optional components
+class Watcher : public System {
+public:
+    Watcher(Engine &engine)
+        : System(engine,
+            engine.ConstructSignature<Position, Velocity>(),
+            Query().With<Position>().Without<Velocity>(),
+            Query().With<Position>().Optional<Velocity>(),
+            Signature()) {}
+
+    void Update(float) override {}
+
+    std::vector<Entity> Sorted(Span<const Entity> targets) const {
+        std::vector<Entity> result(targets.begin(), targets.end());
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    bool operator==(const Watcher &other) const {
+        for (size_t type = 0; type < GetSignatureCount(); type++) {
+            if (Sorted(GetTargetsWithOptional(type)) != Sorted(other.GetTargetsWithOptional(type)) ||
+                Sorted(GetTargetsWithoutOptional(type)) != Sorted(other.GetTargetsWithoutOptional(type)))
+                return false;
+        }
+        return true;
+    }
+};
+
+struct World {
+    Engine engine;
+    Watcher *watcher;
+#if !ARCHETYPE_STORAGE
+    Group<Position, Velocity> *group;
+#endif
+    std::vector<Entity> added;
+    std::vector<Entity> set;
+    std::vector<Entity> entities;
+
+    World() {
+        engine.RegisterComponentTypes<Position, Velocity, Frozen>();
+#if !ARCHETYPE_STORAGE
+        group = &engine.CreateGroup<Position, Velocity>();
+#endif
+        watcher = &engine.RegisterSystem<Watcher>();
+        engine.Observe<Velocity>(ComponentEvent::Add, [&](Span<const Entity> batch) {
+            added.insert(added.end(), batch.begin(), batch.end());
+        });
+        engine.Observe<Velocity>(ComponentEvent::Set, [&](Span<const Entity> batch) {
+            set.insert(set.end(), batch.begin(), batch.end());
+        });
+
+        // Runs of equal signatures, broken up by entities which differ
+        for (Entity entity : engine.CreateEntities(100, Position { 1 }))
+            entities.push_back(entity);
+        for (Entity entity : engine.CreateEntities(10))
+            entities.push_back(entity);
+        for (Entity entity : engine.CreateEntities(30, Position { 2 }, Frozen {}))
+            entities.push_back(entity);
+        for (Entity entity : engine.CreateEntities(20, Position { 3 }, Velocity { 3 }))
+            entities.push_back(entity);
+        for (Entity entity : engine.CreateEntities(40, Position { 4 }))
+            entities.push_back(entity);
+        // Listed twice, the second time it already has the component
+        entities.push_back(entities[5]);
+        entities.push_back(entities[120]);
+    }
+};
+
+int main() {
+    World bulk;
+    World single;
+    CHECK(bulk.entities == single.entities);
+
+    std::vector<Velocity> velocities;
+    for (std::size_t i = 0; i < bulk.entities.size(); i++)
+        velocities.push_back(Velocity { int(i) });
+
+    bulk.engine.AddComponents(Span<const Entity>(bulk.entities), Span<const Velocity>(velocities));
+    for (std::size_t i = 0; i < single.entities.size(); i++)
+        single.engine.SetComponent(single.entities[i], velocities[i]);
+    bulk.engine.DeliverEvents(ObserverPhase::FrameEnd);
+    single.engine.DeliverEvents(ObserverPhase::FrameEnd);
+
+    // One transition per run gives the same targets, events and group as one entity at a time
+    CHECK(*bulk.watcher == *single.watcher);
+    CHECK(bulk.watcher->GetTargetsWithOptional(2).size() == 190);
+    CHECK(bulk.watcher->GetTargetsWithoutOptional(1).size() == 0);
+    CHECK(bulk.added == single.added);
+    CHECK(bulk.set == single.set);
+    for (std::size_t i = 0; i < bulk.entities.size(); i++) {
+        Entity entity = bulk.entities[i];
+        CHECK(bulk.engine.ReadComponent<Velocity>(entity).value ==
+            single.engine.ReadComponent<Velocity>(entity).value);
+    }
+
+#if !ARCHETYPE_STORAGE
+    std::vector<Entity> grouped;
+    bulk.engine.ForEach<Position, Velocity>([&](Entity entity, Position &, Velocity &) {
+        grouped.push_back(entity);
+    });
+    CHECK(grouped.size() == 190);
+    CHECK(bulk.group->GetSize() == 190);
+#endif
+
+    return CheckResult();
+}
@@ -0,0 +1,95 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <string>
+#include <vector>
+
+struct Position {
+    float x, y;
+};
+
+struct Velocity {
+    float x, y;
+};
+
+// Owns heap memory, copying it would allocate
+struct Inventory {
+    std::vector<int> items;
+    std::string name;
+};
+
+class MovementSystem : public System {
+public:
+    MovementSystem(Engine &engine) : System(engine, engine.ConstructSignature<Position, Velocity>()) {
+        Writes<Position>();
+        Reads<Velocity>();
+    }
+
+    void Update(float dt) override {
+        _engine.ForEach<Position, const Velocity>([dt](Position &position, const Velocity &velocity) {
+            position.x += velocity.x * dt;
+            position.y += velocity.y * dt;
+        });
+    }
+};
+
+// Allocations made while running func
+template<typename Func>
+std::size_t CountAllocations(Func func) {
+    std::size_t before = GetHeapAllocationCount();
+    func();
+    return GetHeapAllocationCount() - before;
+}
+
+void CheckInPlaceConstruction() {
+    constexpr int COUNT = 100;
+    Engine engine;
+    engine.RegisterComponentType<Inventory>();
+    std::vector<Entity> entities = engine.CreateEntities(COUNT);
+    engine.GetComponentArray<Inventory>().Reserve(COUNT);
+    // First one allocates pages of the sparse index and change ticks
+    engine.AddComponent<Inventory>(entities[0]);
+
+    std::vector<std::vector<int>> items(COUNT, std::vector<int>(64, 1));
+    std::vector<std::string> names(COUNT, std::string(64, 'a'));
+
+    // Heap data is moved into storage, never copied
+    CHECK(CountAllocations([&] {
+        for (int i = 1; i < COUNT; i++)
+            engine.EmplaceComponent<Inventory>(entities[i], std::move(items[i]), std::move(names[i]));
+    }) == 0);
+    CHECK(engine.ReadComponent<Inventory>(entities[COUNT - 1]).items.size() == 64);
+
+    // Swap-remove moves the last component into the hole
+    CHECK(CountAllocations([&] {
+        for (int i = 1; i < COUNT; i += 2)
+            engine.RemoveComponent<Inventory>(entities[i]);
+    }) == 0);
+    CHECK(engine.ReadComponent<Inventory>(entities[COUNT - 2]).name.size() == 64);
+}
+
+void CheckSteadyFrames(unsigned int thread_count) {
+    Engine engine;
+    engine.RegisterComponentTypes<Position, Velocity>();
+    engine.CreateEntities(10000, Position { 0, 0 }, Velocity { 1, 1 });
+    engine.RegisterSystem<MovementSystem>();
+    if (thread_count)
+        engine.EnableParallelUpdate(thread_count);
+
+    for (int i = 0; i < 4; i++)
+        engine.Update(0.01f);
+
+    // Long enough for job queues to wrap around many times
+    CHECK(CountAllocations([&] {
+        for (int i = 0; i < 256; i++)
+            engine.Update(0.01f);
+    }) == 0);
+}
+
+int main() {
+    CheckInPlaceConstruction();
+    CheckSteadyFrames(0);
+    CheckSteadyFrames(4);
+
+    return CheckResult();
+}
@@ -0,0 +1,88 @@
+#include "engine.hpp"
+#include "check.hpp"
+#include "counting_resource.hpp"
+
+#include <cstddef>
+
+struct Health {
+    int value;
+};
+
+struct Frozen {};
+
+// Tag which opts back into change tracking
+struct Selected {
+    static constexpr bool TRACK_CHANGES = true;
+};
+
+static_assert(!ComponentTracksChanges<Frozen>::value, "Tags are not tracked by default");
+static_assert(ComponentTracksChanges<Selected>::value, "Tags can opt into tracking");
+static_assert(ComponentTracksChanges<Health>::value, "Components with data are tracked");
+
+// Comparison survives the counter wrapping around
+static_assert(IsNewerTick(2, 1) && !IsNewerTick(1, 2) && !IsNewerTick(1, 1));
+static_assert(IsNewerTick(5, Tick(-3)) && !IsNewerTick(Tick(-3), 5));
+static_assert(!IsNewerTick(1 + TICK_HALF_RANGE, 1));
+
+void CheckClamping() {
+    ChangeTicks ticks;
+    ticks.MarkAdded(0, 10);
+    ticks.MarkAdded(1, 10);
+
+    // Entity 1 keeps changing while 0 is left alone for longer than half the range
+    Tick now = 10;
+    for (int i = 0; i < 12; i++) {
+        now += TICK_CLAMP_INTERVAL;
+        ticks.MarkChanged(1, now);
+        ticks.Clamp(now);
+    }
+
+    Tick last_run = now - 1;
+    CHECK(!IsNewerTick(ticks.GetChangedTick(0), last_run));
+    CHECK(!IsNewerTick(ticks.GetAddedTick(0), last_run));
+    CHECK(IsNewerTick(ticks.GetChangedTick(1), last_run));
+    CHECK(Tick(now - ticks.GetAddedTick(0)) == MAX_TICK_AGE);
+}
+
+int main() {
+    constexpr EntityIndex COUNT = 100000;
+    CountingResource resource;
+    {
+        Engine engine(COUNT, &resource);
+        engine.RegisterComponentTypes<Health, Frozen, Selected>();
+
+        // A bit per entity and its sparse index, no tick pages
+        std::size_t before = resource.bytes;
+        std::vector<Entity> frozen = engine.CreateEntities(COUNT, Frozen {});
+        std::size_t tag_bytes = resource.bytes - before;
+        CHECK(tag_bytes < COUNT);
+
+        // Tick pages of tracked components come from the engine's resource too
+        before = resource.bytes;
+        for (Entity entity : frozen)
+            engine.AddComponent<Health>(entity).value = 1;
+        CHECK(resource.bytes - before >= COUNT * (sizeof(Health) + 2 * sizeof(Tick)));
+
+        Tick tick = engine.GetTick();
+        engine.AdvanceTick();
+        engine.AddComponent<Selected>(frozen[7]);
+        engine.MarkChanged<Health>(frozen[3]);
+
+        int selected = 0;
+        engine.GetView<Selected>().AddedSince<Selected>(tick).ForEach([&](Selected &) { selected++; });
+        CHECK(selected == 1);
+
+        // Filters on tracked components still work when an untracked one is joined
+        int changed = 0;
+        engine.GetView<const Health, const Frozen>().ChangedSince<Health>(tick).ForEach([&](Entity entity, const Health &, const Frozen &) {
+            CHECK(entity == frozen[3]);
+            changed++;
+        });
+        CHECK(changed == 1);
+    }
+    CHECK(resource.bytes == 0);
+
+    CheckClamping();
+
+    return CheckResult();
+}
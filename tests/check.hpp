@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdio>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Tests are plain executables: every failed CHECK is reported and main returns CheckResult()
+inline int check_failures = 0;
+
+#define CHECK(condition) \
+    ((condition) ? void() : (std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition), void(check_failures++)))
+
+#if defined(__unix__)
+// Runs statement in a forked child, true when the child was killed by a signal such as a failed assert
+template<typename Func>
+bool Aborts(Func func) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Expected assertion messages would only clutter the test output
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDERR_FILENO);
+        func();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status);
+}
+
+#define CHECK_ABORTS(statement) \
+    ((Aborts([&] { statement; })) ? void() : (std::fprintf(stderr, "%s:%d: CHECK_ABORTS(%s) did not abort\n", __FILE__, __LINE__, #statement), void(check_failures++)))
+#endif
+
+inline int CheckResult() {
+    return check_failures ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct Counter {
+    int value;
+};
+
+// Larger than a command buffer block and than an archetype chunk
+struct Snapshot {
+    std::array<int, 32 * 1024> values;
+};
+
+// Spawns, deletes and changes entities through command buffers from parallel chunks
+class Churn : public System {
+public:
+    Churn(Engine &engine) : System(engine, engine.ConstructSignature<Counter>()) {
+        Reads<Counter>();
+    }
+
+    void Update(float) override {
+        ParallelForEach(0, [&](Entity entity) {
+            CommandBuffer &commands = _engine.GetCommandBuffer();
+            int value = _engine.ReadComponent<Counter>(entity).value;
+            if (value % 5 == 0) {
+                Entity spawned = commands.CreateEntity();
+                commands.SetComponent(spawned, Counter { value + 1 });
+            }
+            if (value % 7 == 0) {
+                // Deleting twice is harmless
+                commands.DeleteEntity(entity);
+                commands.DeleteEntity(entity);
+            } else {
+                commands.SetComponent(entity, Counter { value + 3 });
+            }
+        }, 64);
+    }
+};
+
+// Every entity with its counter, in entity order
+std::vector<std::pair<Entity, int>> Run(unsigned int thread_count) {
+    Engine engine;
+    engine.RegisterComponentType<Counter>();
+    for (int i = 0; i < 2000; i++)
+        engine.SetComponent(engine.CreateEntity(), Counter { i });
+    engine.RegisterSystem<Churn>();
+    if (thread_count)
+        engine.EnableParallelUpdate(thread_count);
+
+    for (int frame = 0; frame < 5; frame++)
+        engine.Update(0.01f);
+
+    std::vector<std::pair<Entity, int>> result;
+    engine.ForEach<Counter>([&](Entity entity, const Counter &counter) {
+        result.push_back({ entity, counter.value });
+    });
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+int main() {
+    // Same entities get the same values however chunks were spread over threads
+    std::vector<std::pair<Entity, int>> serial = Run(0);
+    CHECK(!serial.empty() && serial.size() != 2000);
+    for (int i = 0; i < 4; i++) {
+        CHECK(Run(1) == serial);
+        CHECK(Run(4) == serial);
+    }
+
+    Engine engine;
+    engine.RegisterComponentType<Snapshot>();
+    Entity entity = engine.CreateEntity();
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->values.back() = 7;
+    engine.GetCommandBuffer().SetComponent(entity, *snapshot);
+    engine.FlushCommands();
+    CHECK(engine.ReadComponent<Snapshot>(entity).values.back() == 7);
+
+    // Every such entity gets a chunk of its own, rows move between them on deletion
+    Entity other = engine.CreateEntity();
+    snapshot->values.back() = 9;
+    engine.SetComponent(other, *snapshot);
+    engine.DeleteEntity(entity);
+    CHECK(engine.ReadComponent<Snapshot>(other).values.back() == 9);
+
+    return CheckResult();
+}
@@ -0,0 +1,79 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <type_traits>
+
+struct Position {
+    int value;
+};
+
+struct Velocity {
+    int value;
+};
+
+class Reader : public System {
+public:
+    Reader(Engine &engine) : System(engine, engine.ConstructSignature<const Velocity>()) {
+        Reads<const Velocity>();
+    }
+
+    void Update(float) override {}
+};
+
+class Writer : public System {
+public:
+    Writer(Engine &engine) : System(engine, engine.ConstructSignature<Velocity>()) {
+        Writes<Velocity>();
+    }
+
+    void Update(float) override {}
+};
+
+// const Ts name the same components as Ts, with either storage backend
+int main() {
+    Engine engine;
+    engine.RegisterComponentTypes<Position, Velocity>();
+    std::vector<Entity> moving = engine.CreateEntities(100, Position { 0 }, Velocity { 2 });
+    engine.CreateEntities(50, Position { 0 });
+
+    int visited = 0;
+    engine.ForEach<Position, const Velocity>([&](Position &position, const Velocity &velocity) {
+        position.value += velocity.value;
+        visited++;
+    });
+    CHECK(visited == 100);
+
+    int sum = 0;
+    engine.ForEach<const Position>([&](const Position &position) {
+        sum += position.value;
+    });
+    CHECK(sum == 200);
+
+    // Read-only iteration never hands out a mutable component
+    bool writable = false;
+    engine.ForEach<const Position>([&](auto &position) {
+        writable = writable || !std::is_const_v<std::remove_reference_t<decltype(position)>>;
+    });
+    CHECK(!writable);
+
+    visited = 0;
+    engine.ParallelForEach<const Position, const Velocity>([&](const Position &, const Velocity &) {
+        visited++;
+    });
+    CHECK(visited == 100);
+
+    // Scheduler sees the reader and the writer of Velocity conflict
+    Reader &reader = engine.RegisterSystem<Reader>();
+    Writer &writer = engine.RegisterSystem<Writer>();
+    CHECK(reader.reads == writer.writes);
+    CHECK(reader.signatures[0] == writer.signatures[0]);
+    // Without optional terms every target counts as having all of them
+    CHECK(reader.GetTargetsWithOptional(0).size() == 100);
+    CHECK(reader.GetTargetsWithoutOptional(0).empty());
+    engine.RemoveComponent<Velocity>(moving[0]);
+    engine.RemoveComponent<Velocity>(moving[50]);
+    CHECK(reader.GetTargetsWithOptional(0).size() == 98);
+    CHECK(reader.GetTargetsWithoutOptional(0).empty());
+
+    return CheckResult();
+}
@@ -0,0 +1,39 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <memory>
+
+// Allocates from the heap on demand, the way a careless system would
+class AllocatingSystem : public System {
+public:
+    bool allocate = false;
+    std::unique_ptr<int> last;
+
+    AllocatingSystem(Engine &engine) : System(engine) {}
+
+    void Update(float) override {
+        if (allocate)
+            last = std::make_unique<int>(1);
+    }
+};
+
+int main() {
+    Engine engine;
+    AllocatingSystem &system = engine.RegisterSystem<AllocatingSystem>();
+    for (int i = 0; i < 4; i++)
+        engine.Update(0.01f);
+
+    engine.LockFrameMemory();
+    std::size_t before = GetHeapAllocationCount();
+    engine.Update(0.01f);
+    CHECK(GetHeapAllocationCount() == before);
+
+#if !defined(NDEBUG) && defined(CHECK_ABORTS)
+    // Heap allocation is caught even though frame arenas never grew
+    system.allocate = true;
+    CHECK_ABORTS(engine.Update(0.01f));
+#endif
+    (void)system;
+
+    return CheckResult();
+}
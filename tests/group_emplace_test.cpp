@@ -0,0 +1,37 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+struct Position {
+    int value;
+};
+
+struct Velocity {
+    int value;
+};
+
+int main() {
+    Engine engine;
+    engine.RegisterComponentTypes<Position, Velocity>();
+    engine.CreateGroup<Position, Velocity>();
+
+    // Position of a joins the array first, the grouped one of b gets swapped in front of it
+    Entity a = engine.CreateEntity();
+    engine.AddComponent<Position>(a).value = 1;
+    Entity b = engine.CreateEntity();
+    engine.AddComponent<Velocity>(b).value = 2;
+    engine.AddComponent<Position>(b).value = 3;
+
+    CHECK(engine.ReadComponent<Position>(a).value == 1);
+    CHECK(engine.ReadComponent<Position>(b).value == 3);
+    CHECK(engine.ReadComponent<Velocity>(b).value == 2);
+
+    // Completing the group for a swaps again, the returned reference must follow
+    engine.AddComponent<Velocity>(a).value = 4;
+    engine.GetComponent<Position>(a).value = 5;
+    CHECK(engine.ReadComponent<Velocity>(a).value == 4);
+    CHECK(engine.ReadComponent<Velocity>(b).value == 2);
+    CHECK(engine.ReadComponent<Position>(a).value == 5);
+    CHECK(engine.ReadComponent<Position>(b).value == 3);
+
+    return CheckResult();
+}
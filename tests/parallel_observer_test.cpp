@@ -0,0 +1,50 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+
+struct Health {
+    int value;
+};
+
+// Replaces Health of its targets from every worker, which raises Set events concurrently
+class Healer : public System {
+public:
+    Healer(Engine &engine) : System(engine, engine.ConstructSignature<Health>()) {
+        Writes<Health>();
+    }
+
+    void Update(float) override {
+        ParallelForEach(0, [&](Entity entity) {
+            _engine.SetComponent(entity, Health { _engine.ReadComponent<Health>(entity).value + 1 });
+        }, 64);
+    }
+};
+
+int main() {
+    Engine engine;
+    engine.RegisterComponentType<Health>();
+    std::vector<Entity> entities = engine.CreateEntities(10000, Health { 1 });
+
+    std::vector<Entity> set;
+    int deliveries = 0;
+    engine.Observe<Health>(ComponentEvent::Set, [&](Span<const Entity> batch) {
+        set.insert(set.end(), batch.begin(), batch.end());
+        deliveries++;
+    });
+    engine.RegisterSystem<Healer>();
+    engine.EnableParallelUpdate(4);
+
+    // Batches of every worker arrive merged into one
+    for (int frame = 0; frame < 3; frame++) {
+        set.clear();
+        engine.Update(0.01f);
+        std::sort(set.begin(), set.end());
+        CHECK(set == entities);
+        CHECK(deliveries == frame + 1);
+    }
+    for (Entity entity : entities)
+        CHECK(engine.ReadComponent<Health>(entity).value == 4);
+
+    return CheckResult();
+}
@@ -0,0 +1,62 @@
+#include "engine.hpp"
+#include "check.hpp"
+#include "counting_resource.hpp"
+
+struct Position {
+    float x, y;
+};
+
+struct Velocity {
+    float x, y;
+    using StoragePolicy = DenseStorage;
+};
+
+struct Particle {
+    float x, y, z;
+    using StoragePolicy = SoAStorage<&Particle::x, &Particle::y>;
+};
+
+struct Frozen {};
+
+struct Rare {
+    int value;
+    using StoragePolicy = HashStorage;
+};
+
+int main() {
+    constexpr EntityIndex COUNT = 20000;
+    CountingResource resource;
+    {
+        Engine engine(COUNT, &resource);
+        engine.RegisterComponentTypes<Position, Velocity, Particle, Frozen, Rare>();
+        std::vector<Entity> entities = engine.CreateEntities(COUNT, Position {}, Velocity {}, Particle {});
+        for (EntityIndex i = 0; i < COUNT; i += 3)
+            engine.AddComponent<Frozen>(entities[i]);
+        for (EntityIndex i = 0; i < COUNT; i += 2)
+            engine.DeleteEntity(entities[i]);
+
+        // Everything the pools hold comes from the engine's resource and is reported
+        PoolMemory memory = engine.GetPoolMemory();
+        CHECK(memory.reserved == resource.bytes);
+        CHECK(memory.index > 0 && memory.index < memory.reserved);
+        CHECK(memory.used < memory.reserved - memory.index);
+
+        PoolMemory position = engine.GetPoolMemory<Position>();
+        CHECK(position.used == COUNT / 2 * sizeof(Position));
+        CHECK(position.index >= COUNT / 2 * (sizeof(EntityIndex) + 2 * sizeof(Tick)));
+
+        // Hashed index and entry list follow the live entities, only change ticks stay
+        for (EntityIndex i = 1; i < COUNT; i += 2)
+            engine.AddComponent<Rare>(entities[i]);
+        PoolMemory crowded = engine.GetPoolMemory<Rare>();
+        for (EntityIndex i = 5; i < COUNT; i += 2)
+            engine.RemoveComponent<Rare>(entities[i]);
+        PoolMemory rare = engine.GetPoolMemory<Rare>();
+        CHECK(rare.used == 2 * sizeof(Rare));
+        CHECK(rare.index * 2 < crowded.index);
+        CHECK(engine.ReadComponent<Rare>(entities[1]).value == 0 && engine.ReadComponent<Rare>(entities[3]).value == 0);
+    }
+    CHECK(resource.bytes == 0);
+
+    return CheckResult();
+}
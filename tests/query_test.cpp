@@ -0,0 +1,79 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+#include <random>
+
+template<int N>
+struct Marker {
+    int value;
+};
+
+using A = Marker<0>;
+using B = Marker<1>;
+using C = Marker<2>;
+using D = Marker<3>;
+
+// Every entity the query matches, checked one at a time
+std::vector<Entity> ReferenceQuery(Engine &engine, const std::vector<Entity> &entities, const Query &query) {
+    std::vector<Entity> result;
+    for (Entity entity : entities) {
+        if (engine.IsAlive(entity) && query.Matches(engine.GetSignature(entity)))
+            result.push_back(entity);
+    }
+    return result;
+}
+
+int main() {
+    Engine engine;
+    engine.RegisterComponentTypes<A, B, C, D>();
+
+    // Not a multiple of the block size, with holes left by deletion
+    std::mt19937 rng(3);
+    std::vector<Entity> entities = engine.CreateEntities(1000);
+    for (Entity entity : entities) {
+        unsigned int bits = rng();
+        if (bits & 1)
+            engine.AddComponent<A>(entity);
+        if (bits & 2)
+            engine.AddComponent<B>(entity);
+        if (bits & 4)
+            engine.AddComponent<C>(entity);
+        if (bits & 8)
+            engine.AddComponent<D>(entity);
+    }
+    for (std::size_t i = 0; i < entities.size(); i += 7)
+        engine.DeleteEntity(entities[i]);
+
+    std::vector<Query> queries {
+        Query().With<A>(),
+        Query().With<A, B>().Without<C>(),
+        Query().Without<A, B, C, D>(),
+        Query().AnyOf<C, D>(),
+        Query().With<B>().AnyOf<A, D>().Without<C>(),
+        Query(),
+    };
+    for (const Query &query : queries) {
+        std::vector<Entity> result;
+        engine.QueryEntities(query, result);
+        std::vector<Entity> expected = ReferenceQuery(engine, entities, query);
+        std::sort(result.begin(), result.end());
+        std::sort(expected.begin(), expected.end());
+        CHECK(result == expected);
+        CHECK(!result.empty());
+    }
+
+    // Cached results are dropped when released, or when no one asks for them for a while
+    for (const Query &query : queries)
+        CHECK(engine.GetQueryResult(query).size() == ReferenceQuery(engine, entities, query).size());
+    engine.ReleaseQuery(queries[0]);
+    CHECK(engine.GetCachedQueryCount() == queries.size() - 1);
+    for (std::uint64_t frame = 0; frame < 3 * QUERY_CACHE_IDLE_FRAMES; frame++) {
+        engine.GetQueryResult(queries[1]);
+        engine.Update(0.01f);
+    }
+    CHECK(engine.GetCachedQueryCount() == 1);
+    CHECK(engine.GetQueryResult(queries[1]).size() == ReferenceQuery(engine, entities, queries[1]).size());
+
+    return CheckResult();
+}
@@ -0,0 +1,53 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <atomic>
+
+struct Health {
+    int value;
+};
+
+// Only reads Health, so two of them run at the same time
+class HealthReader : public System {
+public:
+    std::atomic<long> sum { 0 };
+
+    HealthReader(Engine &engine) : System(engine, engine.ConstructSignature<Health>()) {
+        Reads<Health>();
+    }
+
+    void Update(float) override {
+        ParallelForEach(0, [&](Entity entity) {
+            sum.fetch_add(_engine.GetComponent<Health>(entity).value, std::memory_order_relaxed);
+        }, 256);
+    }
+};
+
+int main() {
+    Engine engine;
+    engine.RegisterComponentType<Health>();
+    std::vector<Entity> entities = engine.CreateEntities(10000, Health { 1 });
+
+    HealthReader &first = engine.RegisterSystem<HealthReader>();
+    HealthReader &second = engine.RegisterSystem<HealthReader>();
+    engine.EnableParallelUpdate(4);
+
+    Tick before = engine.GetTick();
+    engine.Update(0.01f);
+    CHECK(first.sum == 10000);
+    CHECK(second.sum == 10000);
+
+    // Reading is not a change
+    bool changed = false;
+    for (Entity entity : entities)
+        changed = changed || engine.IsChangedSince<Health>(entity, before);
+    CHECK(!changed);
+
+    // Writes are marked explicitly
+    engine.GetComponent<Health>(entities[7]).value = 2;
+    engine.MarkChanged<Health>(entities[7]);
+    CHECK(engine.IsChangedSince<Health>(entities[7], before));
+    CHECK(!engine.IsChangedSince<Health>(entities[8], before));
+
+    return CheckResult();
+}
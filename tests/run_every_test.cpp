@@ -0,0 +1,46 @@
+#include "engine.hpp"
+#include "pipeline.hpp"
+#include "check.hpp"
+
+#include <cmath>
+
+// Integrates time the way a dt-based system integrates positions
+class Clock : public System {
+public:
+    float elapsed = 0;
+
+    Clock(Engine &engine) : System(engine) {
+        RunEvery(4, 0);
+    }
+
+    void Update(float dt) override {
+        elapsed += dt;
+    }
+};
+
+bool IsNear(float value, float expected) {
+    return std::fabs(value - expected) < 1e-4f;
+}
+
+// A system running on every 4th step still advances by the whole elapsed time
+int main() {
+    for (unsigned int thread_count : { 0u, 2u }) {
+        Engine engine;
+        engine.SetFixedTimestep(0.01f);
+        if (thread_count)
+            engine.EnableParallelUpdate(thread_count);
+        Clock &clock = engine.RegisterSystem<Clock>();
+        for (int i = 0; i < 40; i++)
+            engine.Update(0.01f);
+        CHECK(IsNear(clock.elapsed, 0.4f));
+    }
+
+    Engine engine;
+    engine.SetFixedTimestep(0.01f);
+    Pipeline<Clock> pipeline(engine);
+    for (int i = 0; i < 40; i++)
+        engine.Update(0.01f, pipeline);
+    CHECK(IsNear(pipeline.Get<Clock>().elapsed, 0.4f));
+
+    return CheckResult();
+}
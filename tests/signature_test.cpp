@@ -0,0 +1,108 @@
+#include "entity.hpp"
+#include "query.hpp"
+#include "check.hpp"
+
+#include <cstdio>
+#include <random>
+
+// Built twice: with the instruction sets ECS_SIMD selects and with none of them
+#if ECS_EXPECT_SIMD && !defined(__SSE4_1__) && !defined(__AVX2__)
+#error "ECS_SIMD did not enable any instruction set"
+#endif
+
+static bool ReferenceIsSufficientFor(const Signature &signature, const Signature &gate) {
+    for (std::size_t i = 0; i < Signature::WORD_COUNT; i++) {
+        if ((signature.words[i] & gate.words[i]) != gate.words[i])
+            return false;
+    }
+    return true;
+}
+
+static bool ReferenceIntersects(const Signature &signature, const Signature &other) {
+    for (std::size_t i = 0; i < Signature::WORD_COUNT; i++) {
+        if (signature.words[i] & other.words[i])
+            return true;
+    }
+    return false;
+}
+
+static bool ReferenceMatches(const Signature &signature, const Query &query) {
+    return ReferenceIsSufficientFor(signature, query.include) && !ReferenceIntersects(signature, query.exclude) &&
+        (query.any_of.IsEmpty() || ReferenceIntersects(signature, query.any_of));
+}
+
+// Few bits, so both outcomes of every check are common, in any word
+static Signature RandomSignature(std::mt19937 &rng) {
+    Signature signature;
+    std::uniform_int_distribution<int> bit_count(0, 4);
+    std::uniform_int_distribution<int> component(0, MAX_COMPONENTS - 1);
+    for (int bits = bit_count(rng); bits > 0; bits--)
+        signature.AddComponent(component(rng));
+    return signature;
+}
+
+int main() {
+#if defined(__AVX2__)
+    std::printf("Signature matching uses AVX2\n");
+#elif defined(__SSE4_1__)
+    std::printf("Signature matching uses SSE4.1\n");
+#else
+    std::printf("Signature matching is scalar\n");
+#endif
+
+    std::mt19937 rng(7);
+    int sufficient = 0;
+    int intersecting = 0;
+    for (int i = 0; i < 100000; i++) {
+        Signature a = RandomSignature(rng);
+        Signature b = RandomSignature(rng);
+        // Supersets pass IsSufficientFor, make sure that path is taken often enough
+        if (i % 2)
+            for (std::size_t w = 0; w < Signature::WORD_COUNT; w++)
+                a.words[w] |= b.words[w];
+
+        bool is_sufficient = a.IsSufficientFor(b);
+        bool intersects = a.Intersects(b);
+        CHECK(is_sufficient == ReferenceIsSufficientFor(a, b));
+        CHECK(intersects == ReferenceIntersects(a, b));
+        sufficient += is_sufficient;
+        intersecting += intersects;
+    }
+    CHECK(sufficient > 10000 && sufficient < 90000);
+    CHECK(intersecting > 10000 && intersecting < 90000);
+
+    // Queries spread over several words test whole signatures, ones within a word read just it
+    int matching = 0;
+    for (int i = 0; i < 2000; i++) {
+        Query query;
+        query.include = RandomSignature(rng);
+        query.exclude = RandomSignature(rng);
+        if (i % 3)
+            query.any_of = RandomSignature(rng);
+        if (i % 2) {
+            for (Signature *term : { &query.include, &query.exclude, &query.any_of })
+                for (std::size_t w = 1; w < Signature::WORD_COUNT; w++)
+                    term->words[w] = 0;
+        }
+
+        std::array<Signature, QueryScan::BLOCK_SIZE> block;
+        for (std::size_t k = 0; k < block.size(); k++) {
+            block[k] = RandomSignature(rng);
+            if (k % 2)
+                for (std::size_t w = 0; w < Signature::WORD_COUNT; w++)
+                    block[k].words[w] |= query.include.words[w] | query.any_of.words[w];
+        }
+
+        // Shorter blocks leave the bits past count clear
+        std::size_t count = i % 5 ? block.size() : i % block.size();
+        std::uint64_t mask = QueryScan(query).MatchBlock(block.data(), count);
+        for (std::size_t k = 0; k < block.size(); k++) {
+            bool expected = k < count && ReferenceMatches(block[k], query);
+            CHECK(((mask >> k) & 1) == expected);
+            matching += expected;
+        }
+    }
+    CHECK(matching > 1000);
+
+    return CheckResult();
+}
@@ -0,0 +1,55 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <type_traits>
+
+// z is not listed, so it is not stored
+struct Particle {
+    float x, y, z;
+    using StoragePolicy = SoAStorage<&Particle::x, &Particle::y>;
+};
+
+int main() {
+    Engine engine;
+    engine.RegisterComponentType<Particle>();
+    std::vector<Entity> entities = engine.CreateEntities(100);
+    for (int i = 0; i < 100; i++)
+        engine.SetComponent(entities[i], Particle { float(i), float(2 * i), 7 });
+
+    // Reads gather the stored fields into a copy
+    Particle read = engine.ReadComponent<Particle>(entities[10]);
+    CHECK(read.x == 10 && read.y == 20 && read.z == 0);
+    static_assert(std::is_same_v<decltype(engine.ReadComponent<Particle>(entities[10])), Particle>);
+
+    // Proxies write through field by field and as a whole
+    auto proxy = engine.GetComponent<Particle>(entities[3]);
+    proxy.Get<&Particle::x>() = 30;
+    CHECK(engine.ReadComponent<Particle>(entities[3]).x == 30);
+    proxy = Particle { 1, 2, 3 };
+    CHECK(engine.ReadComponent<Particle>(entities[3]).x == 1);
+    CHECK(engine.ReadComponent<Particle>(entities[3]).y == 2);
+
+    // Columns hold every entity's field, in the order of the array
+    auto view = engine.GetView<Particle>();
+    Span<float> xs = view.GetColumn<&Particle::x>();
+    Span<float> ys = view.GetColumn<&Particle::y>();
+    CHECK(xs.size() == entities.size() && ys.size() == entities.size());
+    float sum = 0;
+    for (std::size_t i = 0; i < xs.size(); i++) {
+        CHECK(ys[i] == 2 * xs[i] || xs[i] == 1);
+        sum += xs[i];
+    }
+    CHECK(sum == 99 * 100 / 2 - 3 + 1);
+
+    // Read-only iteration gets the fields gathered into a const copy
+    float gathered = 0;
+    bool writable = false;
+    engine.ForEach<const Particle>([&](auto &particle) {
+        writable = writable || !std::is_const_v<std::remove_reference_t<decltype(particle)>>;
+        gathered += particle.x;
+    });
+    CHECK(!writable);
+    CHECK(gathered == sum);
+
+    return CheckResult();
+}
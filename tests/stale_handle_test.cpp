@@ -0,0 +1,44 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+struct Health {
+    int value;
+};
+
+int main() {
+    Engine engine;
+    engine.RegisterComponentType<Health>();
+
+    Entity stale = engine.CreateEntity();
+    engine.AddComponent<Health>(stale).value = 1;
+    engine.DeleteEntity(stale);
+    CHECK(!engine.IsAlive(stale));
+
+    // Reused index gets a new generation, the old handle stays dead
+    Entity reused = engine.CreateEntity();
+    engine.AddComponent<Health>(reused).value = 2;
+    CHECK(GetEntityIndex(reused) == GetEntityIndex(stale));
+    CHECK(engine.IsAlive(reused));
+    CHECK(!engine.IsAlive(stale));
+
+    // Index the engine never handed out
+    Entity forged = MakeEntity(1000000, 0);
+    CHECK(!engine.IsAlive(forged));
+
+#if !defined(NDEBUG) && defined(CHECK_ABORTS)
+    // Stale handles must not reach the component of the entity reusing their index
+    CHECK_ABORTS(engine.GetComponent<Health>(stale));
+    CHECK_ABORTS(engine.ReadComponent<Health>(stale));
+    CHECK_ABORTS(engine.AddComponent<Health>(stale));
+    CHECK_ABORTS(engine.RemoveComponent<Health>(stale));
+    CHECK_ABORTS(engine.DeleteEntity(stale));
+    CHECK_ABORTS(engine.GetSignature(forged));
+#if !ARCHETYPE_STORAGE
+    CHECK_ABORTS(engine.MarkChanged<Health>(stale));
+    CHECK_ABORTS(engine.IsChangedSince<Health>(stale, 0));
+#endif
+#endif
+
+    CHECK(engine.ReadComponent<Health>(reused).value == 2);
+    return CheckResult();
+}
@@ -0,0 +1,72 @@
+#include "engine.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+#include <vector>
+
+struct Position {
+    int value;
+};
+
+class Ordered : public System {
+public:
+    Ordered(Engine &engine) : System(engine, engine.ConstructSignature<Position>()) {
+        KeepInsertionOrder();
+    }
+
+    void Update(float) override {}
+};
+
+class Unordered : public System {
+public:
+    Unordered(Engine &engine) : System(engine, engine.ConstructSignature<Position>()) {}
+
+    void Update(float) override {}
+};
+
+static std::vector<Entity> Targets(const System &system) {
+    Span<const Entity> targets = system.GetTargetsWithOptional(0);
+    return std::vector<Entity>(targets.begin(), targets.end());
+}
+
+int main() {
+    Engine engine;
+    engine.RegisterComponentType<Position>();
+    Ordered &ordered = engine.RegisterSystem<Ordered>();
+    Unordered &unordered = engine.RegisterSystem<Unordered>();
+    std::vector<Entity> entities = engine.CreateEntities(10, Position { 0 });
+    CHECK(Targets(ordered) == entities);
+    CHECK(Targets(unordered) == entities);
+
+    // Stable mode shifts the rest back, from the middle and from the front
+    engine.RemoveComponent<Position>(entities[4]);
+    engine.DeleteEntity(entities[0]);
+    std::vector<Entity> remaining(entities.begin() + 1, entities.end());
+    remaining.erase(remaining.begin() + 3);
+    CHECK(Targets(ordered) == remaining);
+
+    // Default mode moves the last target into the hole
+    std::vector<Entity> swapped = Targets(unordered);
+    CHECK(swapped.size() == 8);
+    CHECK(swapped.front() == entities[8] && swapped[4] == entities[9]);
+    for (Entity entity : entities) {
+        bool kept = entity != entities[0] && entity != entities[4];
+        CHECK(unordered.IsEntityProccessed(entity, 0) == kept);
+        CHECK(std::count(swapped.begin(), swapped.end(), entity) == kept);
+    }
+
+    // Hashed sets forget ordered removals as they do swapped ones
+    PackedArray<int, HashSparseIndex> hashed;
+    for (EntityIndex entry : { 40u, 10u, 70u, 20u, 90u })
+        hashed.SetData(entry, int(entry));
+    hashed.RemoveDataOrdered(70);
+    hashed.RemoveDataOrdered(40);
+    CHECK(hashed.size() == 3);
+    CHECK(hashed.entries == std::vector<int>({ 10, 20, 90 }));
+    CHECK(hashed.GetEntry(0) == 10 && hashed.GetEntry(1) == 20 && hashed.GetEntry(2) == 90);
+    CHECK(!hashed.HasData(70) && !hashed.HasData(40) && hashed.HasData(20));
+    hashed.SetData(70, 7);
+    CHECK(hashed.GetEntry(3) == 70 && hashed.GetData(70) == 7);
+
+    return CheckResult();
+}